@@ -26,26 +26,44 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <signal.h>
+#include <time.h>
 #include "ledhal.h"
 #include "sc_tool.h"
 #include "i2c_test.h"
+#include "ledmgr_rtmsg.h"
 
 #include "ledmgrlogger.h"
 
-extern "C"
-{
-#include "secure_wrapper.h"
-}
-
 //config file path
 #define LED_CONFIG_FILE_PATH "/mnt/ramdisk/tmp/"
 #define LED_CONFIG_FILE_PREFIX ".LED_config_id_"
-#define LED_CONFIG_FILE_NAME_LENGTH 128
+#define LED_CONFIG_FILE_NAME_LENGTH 256
+
+//environment variable to relocate every device and HAL file under a root directory, e.g. a fake sysfs tree
+#define LED_ROOT_ENV "LEDHAL_ROOT"
+#define LED_PATH_MAX_LENGTH 256
 
 //some features of LP5562
 #define LED_LP5562_WAIT_CMD_MAX_STEP 63
 #define LED_LP5562_WAIT_CMD_STEP_TIME 156 //15.6ms * 10
 #define LED_LP5562_BRANCH_CMD_MAX_LOOP 63
+//LP5562 instructions
+#define LED_LP5562_SET_PWM_CMD 0x4000
+#define LED_LP5562_WAIT_CMD_PRESCALE 0x40 //15.6ms steps
+#define LED_LP5562_BRANCH_CMD 0xA000
+#define LED_LP5562_END_CMD 0xD000
+#define LED_LP5562_RAMP_CMD_DECREASE 0x80
+#define LED_LP5562_RAMP_CMD_MAX_INCREMENT 127
+#define LED_LP5562_RAMP_CMD_MAX_STEP 63
+#define LED_LP5562_RAMP_CMD_FAST_STEP_TIME 488 //us, 0.49ms steps
+#define LED_LP5562_RAMP_CMD_SLOW_STEP_TIME 15625 //us, 15.6ms steps
+//every engine has program memory for 16 instructions
+#define LED_LP5562_ENGINE_MAX_INSTRUCTIONS 16
 //16*2+1,every channel support 16 commands, every command consist of 2 bytes, 
 //and we use HEX to represent value of every byte,and the command is a string, so reserve 1 byte for end of the string.
 #define LED_LP5562_COMMAND_LEN	65
@@ -78,18 +96,59 @@ extern "C"
 #define LED_LP5562_DEVICE_PATH "/sys/devices/e8000000.apb/e8007000.i2c/i2c-2/2-0030"
 #define LED_LP5562_I2C_DEVICE "/dev/i2c-2"
 
+//sysfs writer
+#define LED_SYSFS_WRITE_MAX_LENGTH 128
+#define LED_SYSFS_OPEN_RETRY_INTERVAL 5000 //us
+
 //AW210XX device path
 #define LEDS_CHIP_AW210XX_FILE "/tmp/.led_aw210xx"
 #define RGBCOLOR  "/sys/devices/e8000000.apb/e8007000.i2c/i2c-2/2-0020/leds/aw210xx_led/rgbcolor"
 #define REG  "/sys/devices/e8000000.apb/e8007000.i2c/i2c-2/2-0020/leds/aw210xx_led/reg"
+//rgbcolor value is "<led> <current RGB> <pwm RGB>"
+#define LED_AW210XX_VALUE_LEN 32
+#define LED_AW210XX_OFF_VALUE "0x00 0x000000 0x000000"
+//on/off1 for every count and off2
+#define LED_AW210XX_MAX_STEPS ((LED_LP5562_BRANCH_CMD_MAX_LOOP+1)*2+1)
+
+//pattern controller of AW210XX, written through REG
+#define LED_AW210XX_PATTERN_FILE "/tmp/.led_aw210xx_pattern"
+#define LED_AW210XX_PATTERN_TOLERANCE 5 //%, how far a blink time may be from a pattern controller time
+#define LED_AW210XX_PATCFG_REG 0xA0
+#define LED_AW210XX_PATGO_REG 0xA1
+#define LED_AW210XX_PATT0_REG 0xA2 //T1 rise time [7:4], T2 on time [3:0]
+#define LED_AW210XX_PATT1_REG 0xA3 //T3 fall time [7:4], T4 off time [3:0]
+#define LED_AW210XX_PATT2_REG 0xA4 //T0 start delay
+#define LED_AW210XX_PATT3_REG 0xA5 //repeat times, 0 -- forever
+#define LED_AW210XX_FADEH_REG 0xA6
+#define LED_AW210XX_FADEL_REG 0xA7
+#define LED_AW210XX_GCFG0_REG 0xAB
+#define LED_AW210XX_PATCFG_AUTO 0x03 //pattern enable, auto breath mode
+#define LED_AW210XX_PATGO_RUN 0x01
+#define LED_AW210XX_GCFG0_LED0 0x07 //R, G, B of led 0 follow the pattern controller
 
 //current register address of LP5562
 #define LED_LP5562_R_CURRENT_REG 0x07
 #define LED_LP5562_G_CURRENT_REG 0x06
 #define LED_LP5562_B_CURRENT_REG 0x05
 
+//engine registers of LP5562, used when loading engines directly over I2C
+#define LED_LP5562_I2C_ADDR 0x30
+#define LED_LP5562_I2C_LOAD_FILE "/tmp/.led_lp5562_i2c"
+#define LED_LP5562_ENABLE_REG 0x00
+#define LED_LP5562_OP_MODE_REG 0x01
+#define LED_LP5562_ENG_SEL_REG 0x70
+#define LED_LP5562_PROG_MEM_REG(engine) (0x10 + 0x20*(engine))
+#define LED_LP5562_ENABLE_DEFAULT 0xC0 //chip enable, logarithmic pwm, engines hold
+#define LED_LP5562_ENABLE_RUN 0x2A //engine 1~3 run
+#define LED_LP5562_OP_MODE_LOAD 0x15 //engine 1~3 load program
+#define LED_LP5562_OP_MODE_RUN 0x2A //engine 1~3 run program
+#define LED_LP5562_ENG_SEL_RGB 0x1B //R by engine 1, G by engine 2, B by engine 3
+#define LED_LP5562_OP_MODE_DELAY 1000 //us, for the engines to take a new OP_MODE
+#define LED_LP5562_I2C_OPEN_RETRY_TIMES 3
+
 //IR LED brightness file
 #define LED_IRLED_BRIGHTNESS_FILE "/sys/class/backlight/0.pwm_bl/brightness"
+#define LED_IRLED_RAMP_STEP_TIME 20 //ms between brightness writes of a ramp
 
 #define LED_ERROR_MSG_MAX_LENGTH 128
 static char error_msg[LED_ERR_UNKNOWN+1][LED_ERROR_MSG_MAX_LENGTH] = {{0}};
@@ -98,13 +157,28 @@ static char error_msg[LED_ERR_UNKNOWN+1][LED_ERROR_MSG_MAX_LENGTH] = {{0}};
 
 /**
  * @Led action type
- * There are 4 action types, Led_ON, Led_OFF, Led_BLINK and Led_SEQ_BLINK
+ * There are 8 action types, Led_ON, Led_OFF, Led_BLINK, Led_SEQ_BLINK, Led_FADE_IN, Led_FADE_OUT, Led_BREATHE and Led_PATTERN
  * Led_ON        :  turn on Led
  * Led_OFF       :  turn off Led
  * Led_BLINK     :  Led take on/off blink
  * Led_SEQ_BLINK :  firstly, Led repeat on/off1 blink as required times, and then turn off Led off2 milliseconds, and then repeat the whole process
+ * Led_FADE_IN   :  Led fades from off to on in on milliseconds, and stays on
+ * Led_FADE_OUT  :  Led fades from on to off in off milliseconds, and stays off
+ * Led_BREATHE   :  Led fades from off to on in on milliseconds, then back to off in off milliseconds, and then repeat the whole process
+ * Led_PATTERN   :  Led takes the pwm of every step of a pattern for the time of the step, and then repeat the whole process
+*/
+typedef enum Action_Type {Led_ON,Led_OFF,Led_BLINK,Led_SEQ_BLINK,Led_FADE_IN,Led_FADE_OUT,Led_BREATHE,Led_PATTERN} Action_Type;
+
+/**
+ * @brief Led pattern
+ * This structure define the steps of a pattern, see led_setPattern.
+ * @member varible count : number of steps
+ * @member varible step  : steps, pwm of every channel and time
 */
-typedef enum Action_Type {Led_ON,Led_OFF,Led_BLINK,Led_SEQ_BLINK} Action_Type;
+typedef struct Led_Pattern{
+    uint32_t count;
+    ledPatternStep_t step[LED_PATTERN_MAX_STEPS];
+}Led_Pattern;
 
 /**
  * @brief Led action structure
@@ -116,6 +190,7 @@ typedef enum Action_Type {Led_ON,Led_OFF,Led_BLINK,Led_SEQ_BLINK} Action_Type;
  * @member varible off1_time : Led off1 time for sequence blink
  * @member varible count     : repeat number of on_time:off1_time
  * @member varible off2_time : Led off2 time
+ * @member varible pattern   : steps of action pattern
 */
 typedef struct Led_Action{
 	Action_Type act_type;
@@ -124,6 +199,7 @@ typedef struct Led_Action{
 	uint32_t off1_time;
 	uint32_t count;
 	uint32_t off2_time;
+	Led_Pattern pattern;
 }Led_Action;
 
 /**
@@ -152,10 +228,11 @@ typedef struct Led_CHIP{
  * @brief LED IR LED
  * This structure define a description of IR LED
  * @member variable brightness  : brightness of IR LED, 0~255
- * @member variable command     : command of IR LED, 0 -- turn on, 1 -- turn off
+ * @member variable ramp_time   : time in ms to ramp from the brightness shown to a new one, 0 -- change at once
 */
 typedef struct Led_IRLED{
     uint8_t brightness;
+    uint32_t ramp_time;
 }Led_IRLED;
 
 /**
@@ -172,6 +249,8 @@ typedef struct Led_Config{
 	Led_Action	action; 
 }Led_Config;
 
+static ledStats_t* led_stats(void);
+
 /**
  * @brief Lock LED config.
  * This function used to add a lock on LED config file.
@@ -196,6 +275,7 @@ static int lock_led_config(int config_fd)
             {
                 break;
             }
+            __atomic_add_fetch(&led_stats()->config_lock_retries,1,__ATOMIC_RELAXED);
             usleep(5000);
         }
         try_times--;
@@ -287,1144 +367,4464 @@ static int write_led_config(int config_fd, Led_Config* p_led_config)
     return 0;
 }
 
-ledError_t led_init(ledId_t id)
-{
-    char led_config_file[LED_CONFIG_FILE_NAME_LENGTH] = {0};
-    Led_Config led_config;
-    int config_fd = -1;
-    int ret = 0;
-    struct stat config_file_state;
+//shared LED config region, mapped by every process using the HAL. The file name ends with the layout version,
+//a process of another version maps a region of its own instead of reinitializing one in use
+#define LED_CONFIG_SHM_FILE LED_CONFIG_FILE_PATH ".LED_config_shm_v"
+#define LED_CONFIG_SHM_MAGIC 0x4C454443 //"LEDC"
+#define LED_CONFIG_SHM_VERSION 12
+//lock-free snapshot attempts of a config before falling back to its lock
+#define LED_CONFIG_READ_RETRY 100
 
-    LEDMGR_LOG_DEBUG(" %s id: %d\n",__FUNCTION__, id);
-  
-    //check parameter
-    if ((LED_ID_CAMERA_FRONT_PANEL != id) &&(LED_ID_XW_FRONT_PANEL != id) && (LED_ID_CAMERA_IR != id))
-    {
-        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
-        return LED_ERR_INVALID_PARAM;
-    }
+/**
+ * @brief LED config record
+ * This structure define the shared config of a led.
+ * @member variable seq    : seqlock sequence, odd while the config is being written
+ * @member variable loaded : 1 -- config has been loaded from the config file or defaults
+ * @member variable mutex  : process-shared writer lock of the record
+ * @member variable config : LED config
+*/
+typedef struct Led_Config_Record{
+    uint32_t seq;
+    int loaded;
+    pthread_mutex_t mutex;
+    Led_Config config;
+}Led_Config_Record;
 
-    //check if the config file exist or not, and check led config has been writen in the file or not
-	snprintf(led_config_file,LED_CONFIG_FILE_NAME_LENGTH,"%s%s%d",LED_CONFIG_FILE_PATH,LED_CONFIG_FILE_PREFIX,id);
-    if (!access(led_config_file,F_OK))
-    {
-        ret = stat(led_config_file,&config_file_state);
-        if (0 != ret)
-        {
-            snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, get config file stat error\n",__FUNCTION__,__LINE__);
-            return LED_ERR_UNKNOWN;
-        }
-        else
-        {
-            if (sizeof(Led_Config) == config_file_state.st_size)
-            {
-                //LED config has been created
-                return LED_ERR_NONE;
-            }
-        }
-    }
-    
-    if (LED_ID_CAMERA_FRONT_PANEL == id)
-    {
-        led_config.state = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_STATE;
-        //R channel
-        led_config.led_chip.channel[0].current = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_R_CURRENT;
-        led_config.led_chip.channel[0].pwm = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_R_PWM;
-        //G channel
-        led_config.led_chip.channel[1].current = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_G_CURRENT;
-        led_config.led_chip.channel[1].pwm = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_G_PWM;
-        //B channel
-        led_config.led_chip.channel[2].current = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_B_CURRENT;
-        led_config.led_chip.channel[2].pwm = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_B_PWM;
-		//default, turn on xCam2 front Led
-		led_config.action.act_type = Led_ON;
-    }
-    else if (LED_ID_XW_FRONT_PANEL == id)
-    {
-        led_config.state = LED_CONFIG_DEF_XW_FRONT_PANEL_STATE;
-        //R channel
-        led_config.led_chip.channel[0].current = LED_CONFIG_DEF_XW_FRONT_PANEL_R_CURRENT;
-        led_config.led_chip.channel[0].pwm = LED_CONFIG_DEF_XW_FRONT_PANEL_R_PWM;
-        //G channel
-        led_config.led_chip.channel[1].current =  LED_CONFIG_DEF_XW_FRONT_PANEL_G_CURRENT;
-        led_config.led_chip.channel[1].pwm = LED_CONFIG_DEF_XW_FRONT_PANEL_G_PWM;
-        //B channel
-        led_config.led_chip.channel[2].current =  LED_CONFIG_DEF_XW_FRONT_PANEL_B_CURRENT;
-        led_config.led_chip.channel[2].pwm = LED_CONFIG_DEF_XW_FRONT_PANEL_B_PWM;
-		//defalut, turn on XW4 front Led
-		led_config.action.act_type = Led_ON;
-    }
-    else
-    {
-        led_config.state = LED_CONFIG_DEF_IRLED_STATE;
-        led_config.led_irled.brightness = LED_CONFIG_DEF_IRLED_BRIGHTNESS;
-        //default, turn on IR Led;
-		led_config.action.act_type = Led_ON;
-    }
-  
-    //open LED config file
-    config_fd = open(led_config_file,O_WRONLY|O_CREAT|O_EXCL|O_TRUNC,S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH);
-    if (config_fd < 0)
-    {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, open config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
-    }
+/**
+ * @brief LP5562 program
+ * This structure define the programs of the 3 LP5562 engines, engine 1 drives R, engine 2 G and engine 3 B.
+ * @member variable length      : number of instructions of every engine
+ * @member variable instruction : instructions of every engine
+*/
+typedef struct Led_LP5562_Program{
+    uint16_t length[3];
+    uint16_t instruction[3][LED_LP5562_ENGINE_MAX_INSTRUCTIONS];
+}Led_LP5562_Program;
 
-    //lock
-    if(lock_led_config(config_fd))
-    {
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, close config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
-    } 
+/**
+ * @brief LP5562 engine programs
+ * This structure define the programs last loaded into the LP5562 engines.
+ * @member variable valid   : 1 -- program holds what the engines run, 0 -- unknown, engines must be reloaded
+ * @member variable program : program of every engine
+*/
+typedef struct Led_LP5562_Engines{
+    int valid;
+    Led_LP5562_Program program;
+}Led_LP5562_Engines;
 
-    //write init config    
-    ret = write_led_config(config_fd,&led_config);
-    //unlock
-    flock(config_fd,LOCK_UN);
-    close(config_fd);
-    if (0 == ret)
-    {
-        return LED_ERR_NONE;
-    }
-    else
+#define LED_AW210XX_STATE_LEN 128
+#define LED_IRLED_BRIGHTNESS_LEN 8
+#define LED_SIM_STATE_LEN 192
+
+/**
+ * @brief LED devices
+ * Devices driven by the backends, every device has its own lock so applies to different devices run in parallel.
+*/
+typedef enum Led_Hw_Device {LED_HW_AW210XX,LED_HW_LP5562,LED_HW_IRLED,LED_HW_XW,LED_HW_SIM,LED_HW_DEVICE_MAX} Led_Hw_Device;
+
+/**
+ * @brief LED hardware image
+ * This structure define what was last applied to the LED devices, so an apply only writes what differs.
+ * Both front panel leds drive the same LED chip, so the image is kept per device. A value is only
+ * trusted while its valid flag is set, it is cleared before a write and set again once the write succeeded.
+ * @member variable mutex                : process-shared locks, serialize applies to a device, per Led_Hw_Device
+ * @member variable lp5562_current_valid : 1 -- lp5562_current holds the current register, per channel
+ * @member variable lp5562_current       : current registers of LP5562, R, G, B
+ * @member variable lp5562_engines       : programs last loaded into the LP5562 engines
+ * @member variable aw210xx_valid        : 1 -- aw210xx_state is what AW210XX shows
+ * @member variable aw210xx_state        : last color or blink applied to AW210XX
+ * @member variable aw210xx_generation   : incremented by every AW210XX apply, stops blinks of earlier applies
+ * @member variable aw210xx_pid          : process running the AW210XX blink
+ * @member variable aw210xx_pattern      : 1 -- AW210XX pattern controller may be running
+ * @member variable irled_valid          : 1 -- irled_level is what the IR LED brightness file holds
+ * @member variable irled_level          : last brightness written to the IR LED brightness file
+ * @member variable irled_target         : brightness last applied to the IR LED, irled_level once a ramp has finished
+ * @member variable irled_generation     : incremented by every IR LED apply, stops ramps of earlier applies
+ * @member variable irled_ramp           : 1 -- process irled_pid may be ramping the IR LED to irled_target
+ * @member variable irled_pid            : process running the IR LED ramp
+ * @member variable sim_valid            : 1 -- sim_state is what the simulated device shows, per led
+ * @member variable sim_state            : last state written to the simulated device, per led
+*/
+typedef struct Led_Hw_Image{
+    pthread_mutex_t mutex[LED_HW_DEVICE_MAX];
+    int lp5562_current_valid[3];
+    uint8_t lp5562_current[3];
+    Led_LP5562_Engines lp5562_engines;
+    int aw210xx_valid;
+    char aw210xx_state[LED_AW210XX_STATE_LEN];
+    uint32_t aw210xx_generation;
+    pid_t aw210xx_pid;
+    int aw210xx_pattern;
+    int irled_valid;
+    int irled_level;
+    int irled_target;
+    uint32_t irled_generation;
+    int irled_ramp;
+    pid_t irled_pid;
+    int sim_valid[LED_ID_MAX];
+    char sim_state[LED_ID_MAX][LED_SIM_STATE_LEN];
+}Led_Hw_Image;
+
+/**
+ * @brief LED config region
+ * This structure define the layout of LED_CONFIG_SHM_FILE followed by LED_CONFIG_SHM_VERSION.
+ * @member variable magic   : LED_CONFIG_SHM_MAGIC once initialized
+ * @member variable version : LED_CONFIG_SHM_VERSION, layout of the region
+ * @member variable record  : config records, indexed by led id
+ * @member variable hw      : what was last applied to the LED devices
+ * @member variable stats   : HAL counters, see led_getStats
+ * @member variable latency : latency histograms, see led_getLatency
+*/
+typedef struct Led_Config_Shm{
+    uint32_t magic;
+    uint32_t version;
+    Led_Config_Record record[LED_ID_MAX];
+    Led_Hw_Image hw;
+    ledStats_t stats;
+    ledLatency_t latency[LED_LATENCY_MAX];
+}Led_Config_Shm;
+
+//points to the shared region, or to led_config_local if it could not be mapped
+static Led_Config_Shm *led_config_shm = NULL;
+static Led_Config_Shm led_config_local;
+static pthread_once_t led_config_shm_once = PTHREAD_ONCE_INIT;
+//write config changes back to the config file, see LED_OPT_CONFIG_PERSISTENCE
+static int led_config_persistence = 0;
+//load LP5562 engines over I2C instead of sysfs, see LED_OPT_LP5562_I2C_LOAD
+static int led_lp5562_i2c_load = 0;
+//I2C bus of LP5562, opened once and kept for the life of the process, protected by the LP5562 lock of the hardware image
+static int led_lp5562_fd = -1;
+//run AW210XX blinks on the chip's pattern controller, see LED_OPT_AW210XX_PATTERN
+static int led_aw210xx_pattern = 0;
+//update every led on its own thread in led_applyAllSettings and led_resetAll, see LED_OPT_PARALLEL_APPLY
+static int led_parallel_apply = 1;
+
+//fields staged in an update
+#define LED_TXN_FIELD_RESET      0x01
+#define LED_TXN_FIELD_ENABLE     0x02
+#define LED_TXN_FIELD_COLOR      0x04
+#define LED_TXN_FIELD_BRIGHTNESS 0x08
+#define LED_TXN_FIELD_ACTION     0x10
+#define LED_TXN_FIELD_RAMP       0x20
+
+/**
+ * @brief LED config update
+ * This structure define an update of a LED's config, see led_beginUpdate.
+ * @member variable active : 1 -- an update is in progress, the LED's config record is locked by owner
+ * @member variable owner  : thread which began the update
+ * @member variable fields : fields staged so far, LED_TXN_FIELD_*
+ * @member variable config : working copy of LED config, published on commit
+*/
+typedef struct Led_Txn{
+    int active;
+    pthread_t owner;
+    uint32_t fields;
+    Led_Config config;
+}Led_Txn;
+
+static Led_Txn led_txn[LED_ID_MAX];
+
+//capabilities of a LED backend
+#define LED_BACKEND_CAP_COLOR 0x01
+#define LED_BACKEND_CAP_BLINK 0x02
+#define LED_BACKEND_CAP_RAMP  0x04
+#define LED_BACKEND_CAP_PATTERN 0x08
+//environment variable to force the backend of the front panel LEDs, by name
+#define LED_BACKEND_ENV "LEDHAL_BACKEND"
+//files of the simulated device
+#define LED_SIM_PATH LED_CONFIG_FILE_PATH "ledsim"
+#define LED_SIM_LOG_FILE LED_SIM_PATH "/writes.log"
+
+/**
+ * @brief LED backend
+ * This structure define a device driving LEDs. Every LED is bound to a backend on first use, see led_backend_bind.
+ * @member variable name   : name of the backend, as used by LED_BACKEND_ENV
+ * @member variable caps   : capabilities, LED_BACKEND_CAP_*
+ * @member variable detect : 1 -- the backend can drive the LED on this device, NULL -- only used when forced
+ * @member variable init   : prepare the backend to drive the LED, may be NULL
+ * @member variable apply  : apply a LED config to the device, called with the hardware image locked
+ * @member variable latency: latency histogram of apply
+ * @member variable device : device driven, apply holds its lock
+*/
+typedef struct Led_Backend{
+    const char *name;
+    uint32_t caps;
+    int (*detect)(ledId_t id);
+    int (*init)(ledId_t id);
+    int (*apply)(Led_Hw_Image *hw, ledId_t id, Led_Config *led_config);
+    ledLatencyId_t latency;
+    Led_Hw_Device device;
+}Led_Backend;
+
+static int led_apply_config(ledId_t id, Led_Config *led_config);
+static ledError_t led_validate_pattern(const Led_Pattern *pattern);
+static const Led_Backend* led_get_backend(ledId_t id);
+
+/**
+ * @brief Get the path of a device or HAL file.
+ * The path is prefixed with LED_ROOT_ENV if it is set, so the HAL can run against a fake device tree.
+ *
+ * @param [in]  path :  absolute path on the device.
+ * @param [out] buf  :  buffer for the relocated path.
+ *
+ * @return           :  path to use, path itself or buf.
+ */
+static const char* led_path(const char *path, char buf[LED_PATH_MAX_LENGTH])
+{
+    const char *root = getenv(LED_ROOT_ENV);
+
+    if (!root || !root[0])
     {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, write config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        return path;
     }
+    snprintf(buf,LED_PATH_MAX_LENGTH,"%s%s",root,path);
+
+    return buf;
 }
 
-ledError_t led_reset(ledId_t id)
+/**
+ * @brief Get default LED config.
+ *
+ * @param [in]  id           :  Identifier of a led.
+ * @param [out] p_led_config :  pointer of LED config.
+ *
+ * @return                   :  None.
+ */
+static void led_default_config(ledId_t id, Led_Config *p_led_config)
 {
-    char led_config_file[LED_CONFIG_FILE_NAME_LENGTH] = {0};
-    Led_Config led_config;
-    int config_fd = -1;
-    int ret = 0;
+    memset(p_led_config,0,sizeof(Led_Config));
 
-    //check parameter
-    if ((LED_ID_CAMERA_FRONT_PANEL != id) &&(LED_ID_XW_FRONT_PANEL != id) && (LED_ID_CAMERA_IR != id))
-    {
-        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
-        return LED_ERR_INVALID_PARAM;
-    }
-    
-    //default config
     if (LED_ID_CAMERA_FRONT_PANEL == id)
     {
-        led_config.state = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_STATE;
+        p_led_config->state = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_STATE;
         //R channel
-        led_config.led_chip.channel[0].current = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_R_CURRENT;
-        led_config.led_chip.channel[0].pwm = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_R_PWM;
+        p_led_config->led_chip.channel[0].current = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_R_CURRENT;
+        p_led_config->led_chip.channel[0].pwm = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_R_PWM;
         //G channel
-        led_config.led_chip.channel[1].current = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_G_CURRENT;
-        led_config.led_chip.channel[1].pwm = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_G_PWM;
+        p_led_config->led_chip.channel[1].current = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_G_CURRENT;
+        p_led_config->led_chip.channel[1].pwm = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_G_PWM;
         //B channel
-        led_config.led_chip.channel[2].current = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_B_CURRENT;
-        led_config.led_chip.channel[2].pwm = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_B_PWM;
-		//default, turn on xCam2 front Led
-		led_config.action.act_type = Led_ON;
+        p_led_config->led_chip.channel[2].current = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_B_CURRENT;
+        p_led_config->led_chip.channel[2].pwm = LED_CONFIG_DEF_CAMERA_FRONT_PANEL_B_PWM;
+        //default, turn on xCam2 front Led
+        p_led_config->action.act_type = Led_ON;
     }
     else if (LED_ID_XW_FRONT_PANEL == id)
     {
-        led_config.state = LED_CONFIG_DEF_XW_FRONT_PANEL_STATE;
+        p_led_config->state = LED_CONFIG_DEF_XW_FRONT_PANEL_STATE;
         //R channel
-        led_config.led_chip.channel[0].current = LED_CONFIG_DEF_XW_FRONT_PANEL_R_CURRENT;
-        led_config.led_chip.channel[0].pwm = LED_CONFIG_DEF_XW_FRONT_PANEL_R_PWM;
+        p_led_config->led_chip.channel[0].current = LED_CONFIG_DEF_XW_FRONT_PANEL_R_CURRENT;
+        p_led_config->led_chip.channel[0].pwm = LED_CONFIG_DEF_XW_FRONT_PANEL_R_PWM;
         //G channel
-        led_config.led_chip.channel[1].current =  LED_CONFIG_DEF_XW_FRONT_PANEL_G_CURRENT;
-        led_config.led_chip.channel[1].pwm = LED_CONFIG_DEF_XW_FRONT_PANEL_G_PWM;
+        p_led_config->led_chip.channel[1].current = LED_CONFIG_DEF_XW_FRONT_PANEL_G_CURRENT;
+        p_led_config->led_chip.channel[1].pwm = LED_CONFIG_DEF_XW_FRONT_PANEL_G_PWM;
         //B channel
-        led_config.led_chip.channel[2].current =  LED_CONFIG_DEF_XW_FRONT_PANEL_B_CURRENT;
-        led_config.led_chip.channel[2].pwm = LED_CONFIG_DEF_XW_FRONT_PANEL_B_PWM;
-		//default, turn on XW4 front Led
-		led_config.action.act_type = Led_ON;
+        p_led_config->led_chip.channel[2].current = LED_CONFIG_DEF_XW_FRONT_PANEL_B_CURRENT;
+        p_led_config->led_chip.channel[2].pwm = LED_CONFIG_DEF_XW_FRONT_PANEL_B_PWM;
+        //default, turn on XW4 front Led
+        p_led_config->action.act_type = Led_ON;
     }
     else
     {
-        led_config.state = LED_CONFIG_DEF_IRLED_STATE;
-        led_config.led_irled.brightness = LED_CONFIG_DEF_IRLED_BRIGHTNESS;
+        p_led_config->state = LED_CONFIG_DEF_IRLED_STATE;
+        p_led_config->led_irled.brightness = LED_CONFIG_DEF_IRLED_BRIGHTNESS;
         //default, turn on IR Led
-		led_config.action.act_type = Led_ON;
-    }
-
-    //open LED config file
-    snprintf(led_config_file,sizeof(led_config_file),"%s%s%d",LED_CONFIG_FILE_PATH,LED_CONFIG_FILE_PREFIX,id);
-    config_fd = open(led_config_file,O_WRONLY|O_CREAT|O_TRUNC);
-    if (config_fd < 0)
-    {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, open config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
-    }
-  
-    //lock
-    if(lock_led_config(config_fd))
-    {
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, lock config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
-    }
-    
-    //write LED config
-    ret = write_led_config(config_fd,&led_config);
-    //unlock
-    flock(config_fd,LOCK_UN);
-    close(config_fd);
-    if (0 == ret)
-    {
-        return LED_ERR_NONE;
-    }
-    else
-    {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, write config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        p_led_config->action.act_type = Led_ON;
     }
 }
 
-ledError_t led_resetAll()
-{
-    int id = LED_ID_CAMERA_FRONT_PANEL;
-    ledError_t ret = LED_ERR_NONE;
-
-    LEDMGR_LOG_DEBUG(" %s \n",__FUNCTION__);
-    for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++)
-    {
-        ret = led_reset((ledId_t)id);
-        if (LED_ERR_NONE != ret)
-        {
-            LEDMGR_LOG_ERROR(" %s id: %d reset failed, Error %d\n",__FUNCTION__, id, ret);
-            return ret;
-        }
-    }  
-
-    return LED_ERR_NONE;
-}
-
-ledError_t led_setEnable(ledId_t id, int enable)
+/**
+ * @brief Load LED config file.
+ * This function used to read LED config of a led from its config file.
+ *
+ * @param [in]  id           :  Identifier of a led.
+ * @param [out] p_led_config :  pointer of LED config.
+ *
+ * @return                   :  0 success, other value failed.
+ */
+static int led_load_config_file(ledId_t id, Led_Config *p_led_config)
 {
     char led_config_file[LED_CONFIG_FILE_NAME_LENGTH] = {0};
+    char path[LED_PATH_MAX_LENGTH] = {0};
+    struct stat config_file_state;
     int config_fd = -1;
-    Led_Config led_config;
     int ret = -1;
 
-    LEDMGR_LOG_DEBUG(" %s id: %d enable: %d\n",__FUNCTION__, id, enable);
-
-    //check parameter
-    if ((LED_ID_CAMERA_FRONT_PANEL != id) &&(LED_ID_XW_FRONT_PANEL != id) && (LED_ID_CAMERA_IR != id))
+    snprintf(led_config_file,sizeof(led_config_file),"%s%s%d",led_path(LED_CONFIG_FILE_PATH,path),LED_CONFIG_FILE_PREFIX,id);
+    config_fd = open(led_config_file,O_RDONLY);
+    if (config_fd < 0)
     {
-        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
-        return LED_ERR_INVALID_PARAM;
+        return -1;
     }
 
-    if ((1 != enable) && (0 != enable))
+    //check led config has been writen in the file or not
+    if ((0 != fstat(config_fd,&config_file_state)) || (sizeof(Led_Config) != config_file_state.st_size))
     {
-        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] enable value %d is illegal\n",__FUNCTION__,__LINE__,enable);
-        return LED_ERR_INVALID_PARAM;
+        close(config_fd);
+        return -1;
     }
 
-    //open LED config file
-    snprintf(led_config_file,sizeof(led_config_file),"%s%s%d",LED_CONFIG_FILE_PATH,LED_CONFIG_FILE_PREFIX,id);
-    config_fd = open(led_config_file,O_RDWR); 
-    if (config_fd < 0)
-    {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, open config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
-    }
-    //lock
     if (lock_led_config(config_fd))
     {
         close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, lock config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        return -1;
     }
-    //read LED config
-    if (read_led_config(config_fd,&led_config))
-    {
-        flock(config_fd, LOCK_UN);
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, read config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
-    }
-    //update LED config
-    led_config.state = enable;
-    //write LED config
-    ret = write_led_config(config_fd,&led_config);
-    //unlock
+    ret = read_led_config(config_fd,p_led_config);
     flock(config_fd,LOCK_UN);
     close(config_fd);
-    if (0 == ret)
-    {
-        return LED_ERR_NONE;
-    }
-    else
-    {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, write config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
-    }
+
+    return ret;
 }
 
-ledError_t led_setColor(ledId_t id, uint8_t R, uint8_t G, uint8_t B)
+/**
+ * @brief Save LED config file.
+ * This function used to write LED config of a led back to its config file.
+ *
+ * @param [in]  id           :  Identifier of a led.
+ * @param [in]  p_led_config :  pointer of LED config.
+ * @param [out]              :  None.
+ *
+ * @return                   :  0 success, other value failed.
+ */
+static int led_save_config_file(ledId_t id, Led_Config *p_led_config)
 {
     char led_config_file[LED_CONFIG_FILE_NAME_LENGTH] = {0};
+    char path[LED_PATH_MAX_LENGTH] = {0};
     int config_fd = -1;
-    Led_Config led_config;
     int ret = -1;
-    
-    LEDMGR_LOG_DEBUG(" %s id: %d R: %d G: %d B: %d\n",__FUNCTION__, id, R, G, B);
-    
-    //check parameter
-    if ((LED_ID_CAMERA_FRONT_PANEL != id) &&(LED_ID_XW_FRONT_PANEL != id))
-    {
-        if (LED_ID_CAMERA_IR == id)
-        {
-            snprintf(error_msg[LED_ERR_OPERATION_NOT_SUPPORTED],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d does not support set color\n",__FUNCTION__,__LINE__,id);
-            return LED_ERR_OPERATION_NOT_SUPPORTED;
-        }
-        else
-        {
-            snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
-            return LED_ERR_INVALID_PARAM;
-        } 
-    }
 
-    //open LED config file
-    snprintf(led_config_file,sizeof(led_config_file),"%s%s%d",LED_CONFIG_FILE_PATH,LED_CONFIG_FILE_PREFIX,id);
-    config_fd = open(led_config_file,O_RDWR);
+    snprintf(led_config_file,sizeof(led_config_file),"%s%s%d",led_path(LED_CONFIG_FILE_PATH,path),LED_CONFIG_FILE_PREFIX,id);
+    config_fd = open(led_config_file,O_WRONLY|O_CREAT,S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH);
     if (config_fd < 0)
     {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, open config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        return -1;
     }
-    //lock
+
     if (lock_led_config(config_fd))
     {
         close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, lock config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
-    }
-    //read LED config
-    if (read_led_config(config_fd,&led_config))
-    {
-        flock(config_fd,LOCK_UN);
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, read config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        return -1;
     }
-    //check state
-    if (!led_config.state)
+    ret = write_led_config(config_fd,p_led_config);
+    flock(config_fd,LOCK_UN);
+    close(config_fd);
+
+    return ret;
+}
+
+/**
+ * @brief Initialize the record locks of a LED config region.
+ *
+ * @param [in]  shm     :  pointer of LED config region.
+ * @param [in]  pshared :  1 -- region is shared between processes.
+ * @param [out]         :  None.
+ *
+ * @return              :  0 success, other value failed.
+ */
+static int led_config_shm_init(Led_Config_Shm *shm, int pshared)
+{
+    pthread_mutexattr_t attr;
+    int id = LED_ID_CAMERA_FRONT_PANEL;
+    int device = LED_HW_AW210XX;
+    int ret = 0;
+
+    memset(shm,0,sizeof(Led_Config_Shm));
+    pthread_mutexattr_init(&attr);
+    if (pshared)
     {
-        flock(config_fd,LOCK_UN);
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_OPERATION_NOT_SUPPORTED],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] led is disabled, does not support configure\n",__FUNCTION__,__LINE__);
-        return LED_ERR_OPERATION_NOT_SUPPORTED;
+        //a writer killed while holding the lock must not wedge the other processes
+        pthread_mutexattr_setpshared(&attr,PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr,PTHREAD_MUTEX_ROBUST);
     }
-    //update LED config
-    led_config.led_chip.channel[0].current = R;
-    led_config.led_chip.channel[1].current = G;
-    led_config.led_chip.channel[2].current = B;
-    //write LED config
-    ret = write_led_config(config_fd,&led_config);
-    flock(config_fd,LOCK_UN);//unlock
-    close(config_fd);
-    if (0 == ret)
+    for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++)
     {
-        return LED_ERR_NONE;
+        ret |= pthread_mutex_init(&shm->record[id].mutex,&attr);
     }
-    else
+    for (device = LED_HW_AW210XX; device < LED_HW_DEVICE_MAX; device++)
     {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, write config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        ret |= pthread_mutex_init(&shm->hw.mutex[device],&attr);
     }
+    pthread_mutexattr_destroy(&attr);
+
+    shm->version = LED_CONFIG_SHM_VERSION;
+    shm->magic = LED_CONFIG_SHM_MAGIC;
+
+    return ret;
 }
 
-ledError_t led_setBrightness(ledId_t id, uint8_t R, uint8_t G, uint8_t B)
+/**
+ * @brief Map the shared LED config region.
+ * The region is created and initialized by the first process, under an exclusive lock on the file.
+ * Every version of the layout has its own file, so a region in use is never initialized again.
+ * If it can not be mapped the HAL falls back to a config local to this process.
+ *
+ * @param [in]  :  None.
+ * @param [out] :  None.
+ *
+ * @return      :  None.
+ */
+static void led_config_shm_map(void)
 {
-    char led_config_file[LED_CONFIG_FILE_NAME_LENGTH] = {0};
-    int config_fd = -1;
-    Led_Config led_config;
-    int ret = -1;
-
-    LEDMGR_LOG_DEBUG(" %s id: %d R: %d G: %d B: %d\n",__FUNCTION__, id, R, G, B);
+    char path[LED_PATH_MAX_LENGTH] = {0};
+    char shm_file[LED_PATH_MAX_LENGTH] = {0};
+    struct stat shm_state;
+    void *addr = MAP_FAILED;
+    int shm_fd = -1;
 
-     //check parameter
-    if ((LED_ID_CAMERA_FRONT_PANEL != id) &&(LED_ID_XW_FRONT_PANEL != id) && (LED_ID_CAMERA_IR != id))
+    snprintf(shm_file,sizeof(shm_file),"%s%d",led_path(LED_CONFIG_SHM_FILE,path),LED_CONFIG_SHM_VERSION);
+    shm_fd = open(shm_file,O_RDWR|O_CREAT,S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH);
+    if (shm_fd >= 0)
     {
-        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
-        return LED_ERR_INVALID_PARAM;
+        //block until the creator has finished initializing
+        if (0 == flock(shm_fd,LOCK_EX))
+        {
+            if ((0 == fstat(shm_fd,&shm_state)) &&
+                ((shm_state.st_size == sizeof(Led_Config_Shm)) || (0 == ftruncate(shm_fd,sizeof(Led_Config_Shm)))))
+            {
+                addr = mmap(NULL,sizeof(Led_Config_Shm),PROT_READ|PROT_WRITE,MAP_SHARED,shm_fd,0);
+            }
+            //a new file, or one whose creator died initializing it, no process has it in use
+            if ((MAP_FAILED != addr) &&
+                ((LED_CONFIG_SHM_MAGIC != ((Led_Config_Shm *)addr)->magic) || (LED_CONFIG_SHM_VERSION != ((Led_Config_Shm *)addr)->version)))
+            {
+                if (led_config_shm_init((Led_Config_Shm *)addr,1))
+                {
+                    munmap(addr,sizeof(Led_Config_Shm));
+                    addr = MAP_FAILED;
+                }
+            }
+            flock(shm_fd,LOCK_UN);
+        }
+        close(shm_fd);
     }
 
-    //open LED config file
-    snprintf(led_config_file,sizeof(led_config_file),"%s%s%d",LED_CONFIG_FILE_PATH,LED_CONFIG_FILE_PREFIX,id);
-    config_fd = open(led_config_file,O_RDWR);
-    if (config_fd < 0)
-    {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, open config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
-    }
-    //lock
-    if (lock_led_config(config_fd))
+    if (MAP_FAILED == addr)
     {
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, lock config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        LEDMGR_LOG_ERROR(" %s map %s failed, config is local to this process\n",__FUNCTION__,shm_file);
+        led_config_shm_init(&led_config_local,0);
+        led_config_shm = &led_config_local;
     }
-    //read LED config
-    if (read_led_config(config_fd,&led_config))
+    else
     {
-        flock(config_fd, LOCK_UN);
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, read config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        led_config_shm = (Led_Config_Shm *)addr;
     }
-    //check LED state
-    if (!led_config.state)
+}
+
+/**
+ * @brief Get the config record of a led.
+ *
+ * @param [in]  id :  Identifier of a led.
+ * @param [out]    :  None.
+ *
+ * @return         :  pointer of LED config record.
+ */
+static Led_Config_Record* led_config_record(ledId_t id)
+{
+    pthread_once(&led_config_shm_once,led_config_shm_map);
+
+    return &led_config_shm->record[id];
+}
+
+/**
+ * @brief Lock a device in the LED hardware image.
+ * Blocks until the lock is taken. If the previous owner died in the middle of an apply, the image of the device is dropped.
+ *
+ * @param [in]  device :  device to lock.
+ * @param [out]        :  None.
+ *
+ * @return             :  pointer of LED hardware image.
+ */
+static Led_Hw_Image* led_hw_lock(Led_Hw_Device device)
+{
+    Led_Hw_Image *hw = NULL;
+
+    pthread_once(&led_config_shm_once,led_config_shm_map);
+    hw = &led_config_shm->hw;
+    if (EOWNERDEAD == pthread_mutex_lock(&hw->mutex[device]))
     {
-        flock(config_fd, LOCK_UN);
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_OPERATION_NOT_SUPPORTED],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] led is disabled, does not support configure\n",__FUNCTION__,__LINE__);
+        LEDMGR_LOG_WARN(" %s previous owner died, drop hardware image of device %d\n",__FUNCTION__,device);
+        switch (device)
+        {
+            case LED_HW_AW210XX:
+                hw->aw210xx_valid = 0;
+                //keep aw210xx_pattern, it makes the next apply stop a pattern that may still be running
+                break;
+            case LED_HW_LP5562:
+                memset(hw->lp5562_current_valid,0,sizeof(hw->lp5562_current_valid));
+                hw->lp5562_engines.valid = 0;
+                break;
+            case LED_HW_IRLED:
+                hw->irled_valid = 0;
+                break;
+            case LED_HW_SIM:
+                memset(hw->sim_valid,0,sizeof(hw->sim_valid));
+                break;
+            default:
+                break;
+        }
+        pthread_mutex_consistent(&hw->mutex[device]);
+    }
 
-        return LED_ERR_OPERATION_NOT_SUPPORTED;
+    return hw;
+}
+
+/**
+ * @brief Unlock a device in the LED hardware image.
+ *
+ * @param [in]  hw     :  pointer of LED hardware image.
+ * @param [in]  device :  device to unlock.
+ * @param [out]        :  None.
+ *
+ * @return             :  None.
+ */
+static void led_hw_unlock(Led_Hw_Image *hw, Led_Hw_Device device)
+{
+    pthread_mutex_unlock(&hw->mutex[device]);
+}
+
+/**
+ * @brief Get the shared HAL counters.
+ *
+ * @param [in]  :  None.
+ * @param [out] :  None.
+ *
+ * @return      :  pointer of HAL counters.
+ */
+static ledStats_t* led_stats(void)
+{
+    pthread_once(&led_config_shm_once,led_config_shm_map);
+
+    return &led_config_shm->stats;
+}
+
+/**
+ * @brief Get the time for latency measurements.
+ *
+ * @param [in]  :  None.
+ * @param [out] :  None.
+ *
+ * @return      :  monotonic time in us.
+ */
+static uint64_t led_latency_now(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC,&now);
+
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * @brief Record the latency of a call in its shared histogram.
+ *
+ * @param [in]  which :  Entry point called.
+ * @param [in]  start :  time the call started, see led_latency_now.
+ * @param [out]       :  None.
+ *
+ * @return            :  None.
+ */
+static void led_latency_record(ledLatencyId_t which, uint64_t start)
+{
+    ledLatency_t *latency = NULL;
+    uint64_t elapsed = led_latency_now() - start;
+    uint32_t us = (elapsed > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsed;
+    uint32_t max = 0;
+    int bucket = 0;
+
+    pthread_once(&led_config_shm_once,led_config_shm_map);
+    latency = &led_config_shm->latency[which];
+
+    if (us >= LED_LATENCY_BUCKET_MIN_US)
+    {
+        bucket = 32 - __builtin_clz(us / LED_LATENCY_BUCKET_MIN_US);
+        if (bucket >= LED_LATENCY_BUCKETS)
+        {
+            bucket = LED_LATENCY_BUCKETS - 1;
+        }
     }
-    //update LED config
-    if ((LED_ID_CAMERA_FRONT_PANEL == id) || (LED_ID_XW_FRONT_PANEL == id))
+    __atomic_add_fetch(&latency->count,1,__ATOMIC_RELAXED);
+    __atomic_add_fetch(&latency->total_us,us,__ATOMIC_RELAXED);
+    __atomic_add_fetch(&latency->bucket[bucket],1,__ATOMIC_RELAXED);
+    max = __atomic_load_n(&latency->max_us,__ATOMIC_RELAXED);
+    while ((us > max) && !__atomic_compare_exchange_n(&latency->max_us,&max,us,1,__ATOMIC_RELAXED,__ATOMIC_RELAXED))
     {
-        led_config.led_chip.channel[0].pwm = R;
-        led_config.led_chip.channel[1].pwm = G;
-        led_config.led_chip.channel[2].pwm = B;
     }
-    else
+}
+
+/**
+ * @brief Record the latency of an API call and pass its result on.
+ *
+ * @param [in]  which :  Entry point called.
+ * @param [in]  start :  time the call started, see led_latency_now.
+ * @param [in]  ret   :  result of the call.
+ * @param [out]       :  None.
+ *
+ * @return            :  ret.
+ */
+static ledError_t led_latency_return(ledLatencyId_t which, uint64_t start, ledError_t ret)
+{
+    led_latency_record(which,start);
+
+    return ret;
+}
+
+/**
+ * @brief Lock the config record of a led.
+ * Blocks until the lock is taken. If the previous owner died the record is recovered.
+ *
+ * @param [in]  id :  Identifier of a led.
+ * @param [out]    :  None.
+ *
+ * @return         :  None.
+ */
+static void led_config_lock(ledId_t id)
+{
+    Led_Config_Record *record = led_config_record(id);
+
+    if (EOWNERDEAD == pthread_mutex_lock(&record->mutex))
     {
-        led_config.led_irled.brightness = R;
+        LEDMGR_LOG_WARN(" %s id: %d previous owner died, recover config\n",__FUNCTION__, id);
+        //died while publishing, the config may be torn, load it again
+        if (__atomic_load_n(&record->seq,__ATOMIC_RELAXED) & 1)
+        {
+            record->loaded = 0;
+            __atomic_store_n(&record->seq,record->seq + 1,__ATOMIC_RELEASE);
+        }
+        pthread_mutex_consistent(&record->mutex);
     }
-    //write LED config
-    ret = write_led_config(config_fd,&led_config);
-    flock(config_fd, LOCK_UN);
-    close(config_fd);
-    if (0 == ret)
+}
+
+/**
+ * @brief Unlock the config record of a led.
+ *
+ * @param [in]  id :  Identifier of a led.
+ * @param [out]    :  None.
+ *
+ * @return         :  None.
+ */
+static void led_config_unlock(ledId_t id)
+{
+    pthread_mutex_unlock(&led_config_record(id)->mutex);
+}
+
+/**
+ * @brief Publish LED config.
+ * Must be called with the config record of the led locked.
+ *
+ * @param [in]  id           :  Identifier of a led.
+ * @param [in]  p_led_config :  pointer of LED config.
+ * @param [out]              :  None.
+ *
+ * @return                   :  None.
+ */
+static void led_config_publish(ledId_t id, const Led_Config *p_led_config)
+{
+    Led_Config_Record *record = led_config_record(id);
+    uint32_t seq = __atomic_load_n(&record->seq,__ATOMIC_RELAXED);
+
+    __atomic_store_n(&record->seq,seq + 1,__ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&record->config,p_led_config,sizeof(Led_Config));
+    record->loaded = 1;
+    __atomic_store_n(&record->seq,seq + 2,__ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Get LED config.
+ * This function returns the shared config of a led, loading it on first use. The config
+ * is taken from the config file if a valid one exists, otherwise the default config is used.
+ * Must be called with the config record of the led locked.
+ *
+ * @param [in]  id :  Identifier of a led.
+ * @param [out]    :  None.
+ *
+ * @return         :  pointer of LED config.
+ */
+static Led_Config* led_get_config(ledId_t id)
+{
+    Led_Config_Record *record = led_config_record(id);
+    Led_Config led_config;
+
+    if (!record->loaded)
     {
-        return LED_ERR_NONE;
+        if (led_load_config_file(id,&led_config))
+        {
+            led_default_config(id,&led_config);
+            if (led_config_persistence)
+            {
+                led_save_config_file(id,&led_config);
+            }
+        }
+        led_config_publish(id,&led_config);
     }
-    else
+
+    return &record->config;
+}
+
+/**
+ * @brief Read LED config.
+ * This function takes a consistent snapshot of the config of a led without taking its lock,
+ * it retries while a writer is publishing. Only the first read of a led in the system loads it under the lock,
+ * and a read still torn after LED_CONFIG_READ_RETRY attempts takes the lock, recovering a writer that died publishing.
+ *
+ * @param [in]  id           :  Identifier of a led.
+ * @param [out] p_led_config :  pointer of LED config.
+ *
+ * @return                   :  None.
+ */
+static void led_read_config(ledId_t id, Led_Config *p_led_config)
+{
+    Led_Config_Record *record = led_config_record(id);
+    uint32_t seq = 0;
+    int retry = 0;
+
+    if (__atomic_load_n(&record->loaded,__ATOMIC_ACQUIRE))
     {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, write config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        for (retry = 0; retry < LED_CONFIG_READ_RETRY; retry++)
+        {
+            seq = __atomic_load_n(&record->seq,__ATOMIC_ACQUIRE);
+            if (seq & 1)
+            {
+                sched_yield();
+                continue;
+            }
+            memcpy(p_led_config,&record->config,sizeof(Led_Config));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (seq == __atomic_load_n(&record->seq,__ATOMIC_RELAXED))
+            {
+                return;
+            }
+        }
+        LEDMGR_LOG_WARN(" %s id: %d config still being written, read it under the lock\n",__FUNCTION__, id);
     }
+
+    //a writer that died between its sequence increments is only recovered by the lock
+    led_config_lock(id);
+    memcpy(p_led_config,led_get_config(id),sizeof(Led_Config));
+    led_config_unlock(id);
 }
 
-ledError_t led_setBlink(ledId_t id, uint32_t ontime, uint32_t offtime)
+/**
+ * @brief Check the caller owns the update in progress on a led.
+ *
+ * @param [in]  id :  Identifier of a led.
+ * @param [out]    :  None.
+ *
+ * @return         :  1 owned by the calling thread, 0 otherwise.
+ */
+static int led_txn_owned(ledId_t id)
 {
-    char led_config_file[LED_CONFIG_FILE_NAME_LENGTH] = {0};
-    int config_fd = -1;
-    Led_Config led_config;
-    int ret = -1;
+    return led_txn[id].active && pthread_equal(led_txn[id].owner,pthread_self());
+}
 
-    LEDMGR_LOG_DEBUG(" %s id: %d ontime: %d offtime: %d\n",__FUNCTION__, id, ontime, offtime);
+/**
+ * @brief Check the blink timing of an action.
+ *
+ * @param [in]  action :  pointer of LED action.
+ * @param [out]        :  None.
+ *
+ * @return Error Code:  If error code is returned then the timing can not be run by the led.
+ */
+static ledError_t led_validate_action(const Led_Action *action)
+{
+    uint32_t max_time = LED_LP5562_WAIT_CMD_STEP_TIME * LED_LP5562_WAIT_CMD_MAX_STEP * LED_LP5562_BRANCH_CMD_MAX_LOOP;
 
-    //check parameter
-    if ((LED_ID_CAMERA_FRONT_PANEL != id) && (LED_ID_XW_FRONT_PANEL != id))
+    if (Led_PATTERN == action->act_type)
+    {
+        return led_validate_pattern(&action->pattern);
+    }
+
+    if ((Led_FADE_IN == action->act_type) || (Led_FADE_OUT == action->act_type) || (Led_BREATHE == action->act_type))
     {
-        if (LED_ID_CAMERA_IR == id)
+        if (((action->on_time*10) > max_time) || ((action->off_time*10) > max_time))
         {
-            snprintf(error_msg[LED_ERR_OPERATION_NOT_SUPPORTED],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d does not support blink action\n",__FUNCTION__,__LINE__,id);
-            return LED_ERR_OPERATION_NOT_SUPPORTED;
+            snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] fade time value %d/%d is illegal\n",__FUNCTION__,__LINE__,action->on_time,action->off_time);
+            return LED_ERR_INVALID_PARAM;
         }
-        else
+        return LED_ERR_NONE;
+    }
+
+    if ((Led_BLINK != action->act_type) && (Led_SEQ_BLINK != action->act_type))
+    {
+        return LED_ERR_NONE;
+    }
+
+    if ((action->on_time*10) > max_time)
+    {
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] ontime value %d is illegal\n",__FUNCTION__,__LINE__,action->on_time);
+        return LED_ERR_INVALID_PARAM;
+    }
+
+    if (Led_BLINK == action->act_type)
+    {
+        if ((action->off_time*10) > max_time)
         {
-            snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
+            snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] offtime value %d is illegal\n",__FUNCTION__,__LINE__,action->off_time);
             return LED_ERR_INVALID_PARAM;
         }
+        return LED_ERR_NONE;
     }
 
-    if ((ontime*10) > (LED_LP5562_WAIT_CMD_STEP_TIME * LED_LP5562_WAIT_CMD_MAX_STEP * LED_LP5562_BRANCH_CMD_MAX_LOOP))
+    if ((action->off1_time*10) > max_time)
     {
-        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] ontime value %d is illegal\n",__FUNCTION__,__LINE__,ontime);
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] offtime1 value %d is illegal\n",__FUNCTION__,__LINE__,action->off1_time);
         return LED_ERR_INVALID_PARAM;
-    } 
-    if ((offtime*10) > (LED_LP5562_WAIT_CMD_STEP_TIME * LED_LP5562_WAIT_CMD_MAX_STEP * LED_LP5562_BRANCH_CMD_MAX_LOOP))
+    }
+
+    if ((action->off2_time*10) > max_time)
     {
-        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] offtime value %d is illegal\n",__FUNCTION__,__LINE__,offtime);
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] offtime2 value %d is illegal\n",__FUNCTION__,__LINE__,action->off2_time);
         return LED_ERR_INVALID_PARAM;
     }
 
-    //open config file
-    snprintf(led_config_file,sizeof(led_config_file),"%s%s%d",LED_CONFIG_FILE_PATH,LED_CONFIG_FILE_PREFIX,id);
-    config_fd = open(led_config_file,O_RDWR);
-    if (config_fd < 0)
+    if (action->count > (LED_LP5562_BRANCH_CMD_MAX_LOOP+1))
     {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, open config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] count value %d is illegal\n",__FUNCTION__,__LINE__,action->count);
+        return LED_ERR_INVALID_PARAM;
     }
-    //lock
-    if (lock_led_config(config_fd))
+
+    return LED_ERR_NONE;
+}
+
+/**
+ * @brief Validate a staged update.
+ * All checks of an update are done here, once, on the final working config.
+ *
+ * @param [in]  id  :  Identifier of a led.
+ * @param [in]  txn :  update to check.
+ * @param [out]     :  None.
+ *
+ * @return Error Code:  If error code is returned then the update can not be committed.
+ */
+static ledError_t led_validate_txn(ledId_t id, const Led_Txn *txn)
+{
+    ledError_t ret = LED_ERR_NONE;
+    const Led_Backend *backend = led_get_backend(id);
+    uint32_t caps = 0;
+
+    if (!backend)
     {
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, lock config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        snprintf(error_msg[LED_ERR_GENERAL],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d no backend detected\n",__FUNCTION__,__LINE__,id);
+        return LED_ERR_GENERAL;
     }
-    //read LED config
-    if (read_led_config(config_fd,&led_config))
+    caps = backend->caps;
+
+    if ((txn->fields & LED_TXN_FIELD_COLOR) && !(caps & LED_BACKEND_CAP_COLOR))
     {
-        flock(config_fd,LOCK_UN);
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, read config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        snprintf(error_msg[LED_ERR_OPERATION_NOT_SUPPORTED],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d does not support set color\n",__FUNCTION__,__LINE__,id);
+        return LED_ERR_OPERATION_NOT_SUPPORTED;
     }
-    //check LED state
-    if (!led_config.state)
+    if ((txn->fields & LED_TXN_FIELD_ACTION) && !(caps & LED_BACKEND_CAP_BLINK) &&
+        (Led_ON != txn->config.action.act_type) && (Led_OFF != txn->config.action.act_type))
     {
-        flock(config_fd,LOCK_UN);
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_OPERATION_NOT_SUPPORTED],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] led is disabled, does not support configure\n",__FUNCTION__,__LINE__);
+        snprintf(error_msg[LED_ERR_OPERATION_NOT_SUPPORTED],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d does not support blink action\n",__FUNCTION__,__LINE__,id);
+        return LED_ERR_OPERATION_NOT_SUPPORTED;
+    }
+    if ((txn->fields & LED_TXN_FIELD_ACTION) && (Led_PATTERN == txn->config.action.act_type) && !(caps & LED_BACKEND_CAP_PATTERN))
+    {
+        snprintf(error_msg[LED_ERR_OPERATION_NOT_SUPPORTED],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d does not support pattern action\n",__FUNCTION__,__LINE__,id);
+        return LED_ERR_OPERATION_NOT_SUPPORTED;
+    }
+    if ((txn->fields & LED_TXN_FIELD_RAMP) && !(caps & LED_BACKEND_CAP_RAMP))
+    {
+        snprintf(error_msg[LED_ERR_OPERATION_NOT_SUPPORTED],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d does not support brightness ramp\n",__FUNCTION__,__LINE__,id);
         return LED_ERR_OPERATION_NOT_SUPPORTED;
     }
 
-	led_config.action.act_type = Led_BLINK;
-    led_config.action.on_time = ontime;
-	led_config.action.off_time = offtime;
-
-	//write config
-    ret = write_led_config(config_fd, &led_config);
-    flock(config_fd,LOCK_UN);
-    close(config_fd);
-    if (0 == ret)
+    if (txn->fields & LED_TXN_FIELD_ACTION)
     {
-        return LED_ERR_NONE;
+        ret = led_validate_action(&txn->config.action);
+        if (LED_ERR_NONE != ret)
+        {
+            return ret;
+        }
     }
-    else
+
+    //check LED state, a disabled led only accepts enable and reset
+    if ((txn->fields & (LED_TXN_FIELD_COLOR | LED_TXN_FIELD_BRIGHTNESS | LED_TXN_FIELD_ACTION)) && !txn->config.state)
     {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, write config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        snprintf(error_msg[LED_ERR_OPERATION_NOT_SUPPORTED],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] led is disabled, does not support configure\n",__FUNCTION__,__LINE__);
+        return LED_ERR_OPERATION_NOT_SUPPORTED;
     }
+
+    return LED_ERR_NONE;
 }
 
-ledError_t led_setBlinkSequence(ledId_t id, uint32_t ontime, uint32_t offtime1, uint32_t count, uint32_t offtime2)
+/**
+ * @brief Commit the update in progress on a led.
+ * Validates the working config, publishes it and optionally applies it to the device, then ends the update.
+ * Must be called by the owner of the update.
+ *
+ * @param [in]  id    :  Identifier of a led.
+ * @param [in]  apply :  1 -- apply the config to the device after publishing it.
+ * @param [out]       :  None.
+ *
+ * @return Error Code:  If error code is returned then nothing has been published.
+ */
+static ledError_t led_txn_commit(ledId_t id, int apply)
 {
-    char led_config_file[LED_CONFIG_FILE_NAME_LENGTH] = {0};
-    int config_fd = -1;
-    Led_Config led_config;
-    int ret = -1;
+    Led_Txn *txn = &led_txn[id];
+    ledError_t ret = LED_ERR_NONE;
 
-    LEDMGR_LOG_DEBUG(" %s id: %d ontime: %d offtime1: %d count: %d offtime2: %d\n",__FUNCTION__, id, ontime, offtime1, count, offtime2);
-    //check parameters
-    if ((LED_ID_CAMERA_FRONT_PANEL != id) && (LED_ID_XW_FRONT_PANEL != id))
+    ret = led_validate_txn(id,txn);
+    if (LED_ERR_NONE == ret)
     {
-        if (LED_ID_CAMERA_IR == id)
+        //publish whole config at once
+        led_config_publish(id,&txn->config);
+        if (led_config_persistence && led_save_config_file(id,&txn->config))
         {
-            snprintf(error_msg[LED_ERR_OPERATION_NOT_SUPPORTED],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d does not support set sequence blink\n",__FUNCTION__,__LINE__,id);
-            return LED_ERR_OPERATION_NOT_SUPPORTED;
+            snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, write config file error\n",__FUNCTION__,__LINE__);
+            ret = LED_ERR_UNKNOWN;
         }
-        else
+        if (apply && led_apply_config(id,&txn->config))
         {
-            snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
-            return LED_ERR_INVALID_PARAM;
+            snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, apply setting to device error\n",__FUNCTION__,__LINE__);
+            ret = LED_ERR_UNKNOWN;
         }
     }
 
-    if ((ontime*10) > (LED_LP5562_WAIT_CMD_STEP_TIME * LED_LP5562_WAIT_CMD_MAX_STEP * LED_LP5562_BRANCH_CMD_MAX_LOOP)) 
+    txn->active = 0;
+    led_config_unlock(id);
+
+    return ret;
+}
+
+ledError_t led_getSettings(ledId_t id, ledSettings_t *settings)
+{
+    Led_Config led_config;
+    int channel = 0;
+
+    //check parameter
+    if ((LED_ID_CAMERA_FRONT_PANEL != id) &&(LED_ID_XW_FRONT_PANEL != id) && (LED_ID_CAMERA_IR != id))
     {
-        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] ontime value %d is illegal\n",__FUNCTION__,__LINE__,ontime);
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
         return LED_ERR_INVALID_PARAM;
     }
 
-    if ((offtime1*10) > (LED_LP5562_WAIT_CMD_STEP_TIME * LED_LP5562_WAIT_CMD_MAX_STEP * LED_LP5562_BRANCH_CMD_MAX_LOOP))
+    if (NULL == settings)
     {
-        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] offtime1 value %d is illegal\n",__FUNCTION__,__LINE__,offtime1);
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] settings is NULL\n",__FUNCTION__,__LINE__);
         return LED_ERR_INVALID_PARAM;
-    } 
+    }
 
-    if ((offtime2*10) > (LED_LP5562_WAIT_CMD_STEP_TIME * LED_LP5562_WAIT_CMD_MAX_STEP * LED_LP5562_BRANCH_CMD_MAX_LOOP))
+    led_read_config(id,&led_config);
+
+    memset(settings,0,sizeof(ledSettings_t));
+    settings->enable = led_config.state;
+    settings->on = (Led_OFF != led_config.action.act_type) && (Led_FADE_OUT != led_config.action.act_type);
+    if (LED_ID_CAMERA_IR == id)
     {
-        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] offtime2 value %d is illegal\n",__FUNCTION__,__LINE__,offtime2);
-        return LED_ERR_INVALID_PARAM;
+        settings->brightness[0] = led_config.led_irled.brightness;
     }
-
-    if(count > (LED_LP5562_BRANCH_CMD_MAX_LOOP+1))
+    else
     {
-        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] count value %d is illegal\n",__FUNCTION__,__LINE__,count);
-        return LED_ERR_INVALID_PARAM;
+        for (channel = 0; channel < 3; channel++)
+        {
+            settings->color[channel] = led_config.led_chip.channel[channel].current;
+            settings->brightness[channel] = led_config.led_chip.channel[channel].pwm;
+        }
     }
-  
-    //open LED config file
-    snprintf(led_config_file,sizeof(led_config_file),"%s%s%d",LED_CONFIG_FILE_PATH,LED_CONFIG_FILE_PREFIX,id);
-    config_fd = open(led_config_file,O_RDWR);
-    if (config_fd < 0)
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_beginUpdate(ledId_t id)
+{
+    //check parameter
+    if ((LED_ID_CAMERA_FRONT_PANEL != id) &&(LED_ID_XW_FRONT_PANEL != id) && (LED_ID_CAMERA_IR != id))
     {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, open config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
+        return LED_ERR_INVALID_PARAM;
     }
-    //lock
-    if (lock_led_config(config_fd))
+
+    if (led_txn_owned(id))
     {
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, lock config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        snprintf(error_msg[LED_ERR_GENERAL],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] update of id %d already in progress\n",__FUNCTION__,__LINE__,id);
+        return LED_ERR_GENERAL;
     }
-    //read LED config file
-    if (read_led_config(config_fd,&led_config))
+
+    led_config_lock(id);
+    led_txn[id].active = 1;
+    led_txn[id].owner = pthread_self();
+    led_txn[id].fields = 0;
+    memcpy(&led_txn[id].config,led_get_config(id),sizeof(Led_Config));
+
+    return LED_ERR_NONE;
+}
+
+/**
+ * @brief Check the caller can stage into the update on a led.
+ *
+ * @param [in]  id       :  Identifier of a led.
+ * @param [in]  function :  calling API, for the error message.
+ * @param [out]          :  None.
+ *
+ * @return Error Code:  If error code is returned then there is no update of the caller in progress on the led.
+ */
+static ledError_t led_txn_check(ledId_t id, const char *function)
+{
+    if ((LED_ID_CAMERA_FRONT_PANEL != id) &&(LED_ID_XW_FRONT_PANEL != id) && (LED_ID_CAMERA_IR != id))
+    {
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",function,__LINE__,id);
+        return LED_ERR_INVALID_PARAM;
+    }
+
+    if (!led_txn_owned(id))
+    {
+        snprintf(error_msg[LED_ERR_GENERAL],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] no update of id %d in progress\n",function,__LINE__,id);
+        return LED_ERR_GENERAL;
+    }
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_stageReset(ledId_t id)
+{
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+    Led_Txn *txn = NULL;
+
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+    txn = &led_txn[id];
+
+    led_default_config(id,&txn->config);
+    txn->fields |= LED_TXN_FIELD_RESET;
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_stageEnable(ledId_t id, int enable)
+{
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+    Led_Txn *txn = NULL;
+
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+    txn = &led_txn[id];
+
+    if ((1 != enable) && (0 != enable))
+    {
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] enable value %d is illegal\n",__FUNCTION__,__LINE__,enable);
+        return LED_ERR_INVALID_PARAM;
+    }
+
+    txn->config.state = enable;
+    txn->fields |= LED_TXN_FIELD_ENABLE;
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_stageColor(ledId_t id, uint8_t R, uint8_t G, uint8_t B)
+{
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+    Led_Txn *txn = NULL;
+
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+    txn = &led_txn[id];
+
+    txn->config.led_chip.channel[0].current = R;
+    txn->config.led_chip.channel[1].current = G;
+    txn->config.led_chip.channel[2].current = B;
+    txn->fields |= LED_TXN_FIELD_COLOR;
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_stageBrightness(ledId_t id, uint8_t R, uint8_t G, uint8_t B)
+{
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+    Led_Txn *txn = NULL;
+
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+    txn = &led_txn[id];
+
+    if (LED_ID_CAMERA_IR == id)
+    {
+        txn->config.led_irled.brightness = R;
+    }
+    else
+    {
+        txn->config.led_chip.channel[0].pwm = R;
+        txn->config.led_chip.channel[1].pwm = G;
+        txn->config.led_chip.channel[2].pwm = B;
+    }
+    txn->fields |= LED_TXN_FIELD_BRIGHTNESS;
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_stageIrBrightness(ledId_t id, uint8_t brightness, uint32_t ramptime)
+{
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+    Led_Txn *txn = NULL;
+
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+    txn = &led_txn[id];
+
+    txn->config.led_irled.brightness = brightness;
+    txn->config.led_irled.ramp_time = ramptime;
+    txn->fields |= LED_TXN_FIELD_BRIGHTNESS | LED_TXN_FIELD_RAMP;
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_stageBlink(ledId_t id, uint32_t ontime, uint32_t offtime)
+{
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+    Led_Txn *txn = NULL;
+
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+    txn = &led_txn[id];
+
+    txn->config.action.act_type = Led_BLINK;
+    txn->config.action.on_time = ontime;
+    txn->config.action.off_time = offtime;
+    txn->fields |= LED_TXN_FIELD_ACTION;
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_stageFade(ledId_t id, int fadein, uint32_t fadetime)
+{
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+    Led_Txn *txn = NULL;
+
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+    txn = &led_txn[id];
+
+    memset(&txn->config.action,0,sizeof(Led_Action));
+    if (fadein)
+    {
+        txn->config.action.act_type = Led_FADE_IN;
+        txn->config.action.on_time = fadetime;
+    }
+    else
+    {
+        txn->config.action.act_type = Led_FADE_OUT;
+        txn->config.action.off_time = fadetime;
+    }
+    txn->fields |= LED_TXN_FIELD_ACTION;
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_stageBreathe(ledId_t id, uint32_t risetime, uint32_t falltime)
+{
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+    Led_Txn *txn = NULL;
+
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+    txn = &led_txn[id];
+
+    memset(&txn->config.action,0,sizeof(Led_Action));
+    txn->config.action.act_type = Led_BREATHE;
+    txn->config.action.on_time = risetime;
+    txn->config.action.off_time = falltime;
+    txn->fields |= LED_TXN_FIELD_ACTION;
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_stagePattern(ledId_t id, const ledPatternStep_t *steps, uint32_t n)
+{
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+    Led_Txn *txn = NULL;
+    uint32_t i = 0;
+
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+    if ((NULL == steps) || (0 == n) || (n > LED_PATTERN_MAX_STEPS))
+    {
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] pattern of %d steps is illegal\n",__FUNCTION__,__LINE__,n);
+        return LED_ERR_INVALID_PARAM;
+    }
+    txn = &led_txn[id];
+
+    memset(&txn->config.action,0,sizeof(Led_Action));
+    txn->config.action.act_type = Led_PATTERN;
+    txn->config.action.pattern.count = n;
+    for (i = 0; i < n; i++)
+    {
+        memcpy(txn->config.action.pattern.step[i].pwm,steps[i].pwm,sizeof(steps[i].pwm));
+        txn->config.action.pattern.step[i].duration = steps[i].duration;
+    }
+    txn->fields |= LED_TXN_FIELD_ACTION;
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_stageColorSequence(ledId_t id, const ledColorStep_t *steps, uint32_t n)
+{
+    ledPatternStep_t pattern[LED_PATTERN_MAX_STEPS];
+    uint8_t color[3] = {0};
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+    uint32_t i = 0;
+    int channel = 0;
+
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+    if ((NULL == steps) || (0 == n) || (n > LED_PATTERN_MAX_STEPS))
+    {
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] sequence of %d steps is illegal\n",__FUNCTION__,__LINE__,n);
+        return LED_ERR_INVALID_PARAM;
+    }
+
+    //the color of a channel holds for the whole pattern, take the largest and scale the brightness of the other steps to it
+    for (i = 0; i < n; i++)
+    {
+        for (channel = 0; channel < 3; channel++)
+        {
+            if (steps[i].color[channel] > color[channel])
+            {
+                color[channel] = steps[i].color[channel];
+            }
+        }
+    }
+    memset(pattern,0,sizeof(pattern));
+    for (i = 0; i < n; i++)
+    {
+        for (channel = 0; channel < 3; channel++)
+        {
+            if (color[channel])
+            {
+                pattern[i].pwm[channel] = (uint8_t)((steps[i].brightness[channel] * steps[i].color[channel] + color[channel] / 2) / color[channel]);
+            }
+        }
+        pattern[i].duration = steps[i].duration;
+    }
+
+    ret = led_stageColor(id,color[0],color[1],color[2]);
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+    //brightness of the first step, as read back by led_getSettings
+    ret = led_stageBrightness(id,pattern[0].pwm[0],pattern[0].pwm[1],pattern[0].pwm[2]);
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+
+    return led_stagePattern(id,pattern,n);
+}
+
+ledError_t led_stageBlinkSequence(ledId_t id, uint32_t ontime, uint32_t offtime1, uint32_t count, uint32_t offtime2)
+{
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+    Led_Txn *txn = NULL;
+
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+    txn = &led_txn[id];
+
+    txn->config.action.act_type = Led_SEQ_BLINK;
+    txn->config.action.on_time = ontime;
+    txn->config.action.off1_time = offtime1;
+    txn->config.action.count = count;
+    txn->config.action.off2_time = offtime2;
+    txn->fields |= LED_TXN_FIELD_ACTION;
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_stageOnOff(ledId_t id, const char* onoff)
+{
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+    Led_Txn *txn = NULL;
+
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+    txn = &led_txn[id];
+
+    if ((strcmp(onoff,"on")) && (strcmp(onoff,"off")))
+    {
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] onoff value %s is illegal\n",__FUNCTION__,__LINE__,onoff);
+        return LED_ERR_INVALID_PARAM;
+    }
+
+    txn->config.action.act_type = strcmp(onoff,"on") ? Led_OFF : Led_ON;
+    txn->fields |= LED_TXN_FIELD_ACTION;
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_commitUpdate(ledId_t id, int apply)
+{
+    uint64_t start = led_latency_now();
+
+    LEDMGR_LOG_DEBUG(" %s id: %d apply: %d\n",__FUNCTION__, id, apply);
+
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+
+    if (LED_ERR_NONE != ret)
+    {
+        return led_latency_return(LED_LATENCY_COMMIT_UPDATE,start,ret);
+    }
+
+    return led_latency_return(LED_LATENCY_COMMIT_UPDATE,start,led_txn_commit(id,apply));
+}
+
+ledError_t led_abortUpdate(ledId_t id)
+{
+    ledError_t ret = led_txn_check(id,__FUNCTION__);
+
+    if (LED_ERR_NONE != ret)
+    {
+        return ret;
+    }
+
+    led_txn[id].active = 0;
+    led_config_unlock(id);
+
+    return LED_ERR_NONE;
+}
+
+/**
+ * @brief Work on a led in an update of all leds
+ * @member variable function : API run on the led
+ * @member variable id       : Identifier of the led
+ * @member variable ret      : result of function
+*/
+typedef struct Led_All_Work{
+    ledError_t (*function)(ledId_t id);
+    ledId_t id;
+    ledError_t ret;
+}Led_All_Work;
+
+/**
+ * @brief Run the work on a led in an update of all leds.
+ *
+ * @param [in]  arg :  pointer of Led_All_Work.
+ * @param [out]     :  None.
+ *
+ * @return          :  NULL.
+ */
+static void* led_for_all_thread(void *arg)
+{
+    Led_All_Work *work = (Led_All_Work *)arg;
+
+    work->ret = work->function(work->id);
+
+    return NULL;
+}
+
+/**
+ * @brief Run an API on every led.
+ * Every led is a different device, so an API writing the devices can run each led on its own thread and
+ * the update takes as long as the slowest led. A failing led does not stop the others.
+ *
+ * @param [in]  function :  API to run on every led.
+ * @param [in]  parallel :  1 run the leds on threads, for APIs which wait for the devices; 0 run them in turn.
+ * @param [out] status   :  result of every led, may be NULL.
+ *
+ * @return Error Code    :  first error of the leds, in led order.
+ */
+static ledError_t led_for_all(ledError_t (*function)(ledId_t id), int parallel, ledError_t status[LED_ID_MAX])
+{
+    Led_All_Work work[LED_ID_MAX];
+    pthread_t thread[LED_ID_MAX];
+    int started[LED_ID_MAX] = {0};
+    ledError_t ret = LED_ERR_NONE;
+    int id = LED_ID_CAMERA_FRONT_PANEL;
+
+    for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++)
+    {
+        work[id].function = function;
+        work[id].id = (ledId_t)id;
+        work[id].ret = LED_ERR_NONE;
+        //the last led runs on this thread, so do leds with an update of this thread in progress, a worker would wait for the update
+        if (parallel && (id < (LED_ID_MAX - 1)) && !led_txn_owned((ledId_t)id) &&
+            (0 == pthread_create(&thread[id],NULL,led_for_all_thread,&work[id])))
+        {
+            started[id] = 1;
+        }
+    }
+    for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++)
+    {
+        if (!started[id])
+        {
+            led_for_all_thread(&work[id]);
+        }
+    }
+
+    for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++)
+    {
+        if (started[id])
+        {
+            pthread_join(thread[id],NULL);
+        }
+        if (status)
+        {
+            status[id] = work[id].ret;
+        }
+        if (LED_ERR_NONE != work[id].ret)
+        {
+            LEDMGR_LOG_ERROR(" %s id: %d failed, Error %d\n",__FUNCTION__, id, work[id].ret);
+            if (LED_ERR_NONE == ret)
+            {
+                ret = work[id].ret;
+            }
+        }
+    }
+
+    return ret;
+}
+
+ledError_t led_init(ledId_t id)
+{
+    uint64_t start = led_latency_now();
+    const Led_Backend *backend = NULL;
+
+    LEDMGR_LOG_DEBUG(" %s id: %d\n",__FUNCTION__, id);
+
+    //check parameter
+    if ((LED_ID_CAMERA_FRONT_PANEL != id) &&(LED_ID_XW_FRONT_PANEL != id) && (LED_ID_CAMERA_IR != id))
+    {
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
+        return led_latency_return(LED_LATENCY_INIT,start,LED_ERR_INVALID_PARAM);
+    }
+
+    if (!led_txn_owned(id))
+    {
+        led_config_lock(id);
+        led_get_config(id);
+        led_config_unlock(id);
+    }
+
+    //bind the led to its backend and prepare it now, so applies do not pay for it
+    backend = led_get_backend(id);
+    if (!backend)
+    {
+        snprintf(error_msg[LED_ERR_GENERAL],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d no backend detected\n",__FUNCTION__,__LINE__,id);
+        return led_latency_return(LED_LATENCY_INIT,start,LED_ERR_GENERAL);
+    }
+    if (backend->init && backend->init(id))
+    {
+        LEDMGR_LOG_WARN(" %s init backend %s of id %d failed\n",__FUNCTION__,backend->name,id);
+    }
+
+    return led_latency_return(LED_LATENCY_INIT,start,LED_ERR_NONE);
+}
+
+ledError_t led_reset(ledId_t id)
+{
+    uint64_t start = led_latency_now();
+    ledError_t ret = led_beginUpdate(id);
+
+    if (LED_ERR_NONE != ret)
+    {
+        return led_latency_return(LED_LATENCY_RESET,start,ret);
+    }
+    led_stageReset(id);
+
+    return led_latency_return(LED_LATENCY_RESET,start,led_txn_commit(id,0));
+}
+
+ledError_t led_resetAll()
+{
+    LEDMGR_LOG_DEBUG(" %s \n",__FUNCTION__);
+
+    //reset only stages the config, threads would cost more than they save
+    return led_for_all(led_reset,0,NULL);
+}
+
+ledError_t led_resetAllEx(ledError_t status[LED_ID_MAX])
+{
+    LEDMGR_LOG_DEBUG(" %s \n",__FUNCTION__);
+
+    return led_for_all(led_reset,0,status);
+}
+
+ledError_t led_setEnable(ledId_t id, int enable)
+{
+    uint64_t start = led_latency_now();
+    ledError_t ret = LED_ERR_NONE;
+
+    LEDMGR_LOG_DEBUG(" %s id: %d enable: %d\n",__FUNCTION__, id, enable);
+
+    ret = led_beginUpdate(id);
+    if (LED_ERR_NONE != ret)
+    {
+        return led_latency_return(LED_LATENCY_SET_ENABLE,start,ret);
+    }
+    ret = led_stageEnable(id,enable);
+    if (LED_ERR_NONE != ret)
+    {
+        led_abortUpdate(id);
+        return led_latency_return(LED_LATENCY_SET_ENABLE,start,ret);
+    }
+
+    return led_latency_return(LED_LATENCY_SET_ENABLE,start,led_txn_commit(id,0));
+}
+
+ledError_t led_setColor(ledId_t id, uint8_t R, uint8_t G, uint8_t B)
+{
+    uint64_t start = led_latency_now();
+    ledError_t ret = LED_ERR_NONE;
+
+    LEDMGR_LOG_DEBUG(" %s id: %d R: %d G: %d B: %d\n",__FUNCTION__, id, R, G, B);
+
+    ret = led_beginUpdate(id);
+    if (LED_ERR_NONE != ret)
+    {
+        return led_latency_return(LED_LATENCY_SET_COLOR,start,ret);
+    }
+    led_stageColor(id,R,G,B);
+
+    return led_latency_return(LED_LATENCY_SET_COLOR,start,led_txn_commit(id,0));
+}
+
+ledError_t led_setBrightness(ledId_t id, uint8_t R, uint8_t G, uint8_t B)
+{
+    uint64_t start = led_latency_now();
+    ledError_t ret = LED_ERR_NONE;
+
+    LEDMGR_LOG_DEBUG(" %s id: %d R: %d G: %d B: %d\n",__FUNCTION__, id, R, G, B);
+
+    ret = led_beginUpdate(id);
+    if (LED_ERR_NONE != ret)
+    {
+        return led_latency_return(LED_LATENCY_SET_BRIGHTNESS,start,ret);
+    }
+    led_stageBrightness(id,R,G,B);
+
+    return led_latency_return(LED_LATENCY_SET_BRIGHTNESS,start,led_txn_commit(id,0));
+}
+
+ledError_t led_setIrBrightness(ledId_t id, uint8_t brightness, uint32_t ramptime)
+{
+    uint64_t start = led_latency_now();
+    ledError_t ret = LED_ERR_NONE;
+
+    LEDMGR_LOG_DEBUG(" %s id: %d brightness: %d ramptime: %d\n",__FUNCTION__, id, brightness, ramptime);
+
+    ret = led_beginUpdate(id);
+    if (LED_ERR_NONE != ret)
+    {
+        return led_latency_return(LED_LATENCY_SET_IR_BRIGHTNESS,start,ret);
+    }
+    led_stageIrBrightness(id,brightness,ramptime);
+
+    return led_latency_return(LED_LATENCY_SET_IR_BRIGHTNESS,start,led_txn_commit(id,0));
+}
+
+ledError_t led_setBlink(ledId_t id, uint32_t ontime, uint32_t offtime)
+{
+    uint64_t start = led_latency_now();
+    ledError_t ret = LED_ERR_NONE;
+
+    LEDMGR_LOG_DEBUG(" %s id: %d ontime: %d offtime: %d\n",__FUNCTION__, id, ontime, offtime);
+
+    ret = led_beginUpdate(id);
+    if (LED_ERR_NONE != ret)
+    {
+        return led_latency_return(LED_LATENCY_SET_BLINK,start,ret);
+    }
+    led_stageBlink(id,ontime,offtime);
+
+    return led_latency_return(LED_LATENCY_SET_BLINK,start,led_txn_commit(id,0));
+}
+
+ledError_t led_setFade(ledId_t id, int fadein, uint32_t fadetime)
+{
+    uint64_t start = led_latency_now();
+    ledError_t ret = LED_ERR_NONE;
+
+    LEDMGR_LOG_DEBUG(" %s id: %d fadein: %d fadetime: %d\n",__FUNCTION__, id, fadein, fadetime);
+
+    ret = led_beginUpdate(id);
+    if (LED_ERR_NONE != ret)
+    {
+        return led_latency_return(LED_LATENCY_SET_FADE,start,ret);
+    }
+    led_stageFade(id,fadein,fadetime);
+
+    return led_latency_return(LED_LATENCY_SET_FADE,start,led_txn_commit(id,0));
+}
+
+ledError_t led_setBreathe(ledId_t id, uint32_t risetime, uint32_t falltime)
+{
+    uint64_t start = led_latency_now();
+    ledError_t ret = LED_ERR_NONE;
+
+    LEDMGR_LOG_DEBUG(" %s id: %d risetime: %d falltime: %d\n",__FUNCTION__, id, risetime, falltime);
+
+    ret = led_beginUpdate(id);
+    if (LED_ERR_NONE != ret)
+    {
+        return led_latency_return(LED_LATENCY_SET_BREATHE,start,ret);
+    }
+    led_stageBreathe(id,risetime,falltime);
+
+    return led_latency_return(LED_LATENCY_SET_BREATHE,start,led_txn_commit(id,0));
+}
+
+ledError_t led_setPattern(ledId_t id, const ledPatternStep_t *steps, uint32_t n)
+{
+    uint64_t start = led_latency_now();
+    ledError_t ret = LED_ERR_NONE;
+
+    LEDMGR_LOG_DEBUG(" %s id: %d steps: %d\n",__FUNCTION__, id, n);
+
+    ret = led_beginUpdate(id);
+    if (LED_ERR_NONE != ret)
+    {
+        return led_latency_return(LED_LATENCY_SET_PATTERN,start,ret);
+    }
+    ret = led_stagePattern(id,steps,n);
+    if (LED_ERR_NONE != ret)
+    {
+        led_abortUpdate(id);
+        return led_latency_return(LED_LATENCY_SET_PATTERN,start,ret);
+    }
+
+    return led_latency_return(LED_LATENCY_SET_PATTERN,start,led_txn_commit(id,0));
+}
+
+ledError_t led_setColorSequence(ledId_t id, const ledColorStep_t *steps, uint32_t n)
+{
+    uint64_t start = led_latency_now();
+    ledError_t ret = LED_ERR_NONE;
+
+    LEDMGR_LOG_DEBUG(" %s id: %d steps: %d\n",__FUNCTION__, id, n);
+
+    ret = led_beginUpdate(id);
+    if (LED_ERR_NONE != ret)
+    {
+        return led_latency_return(LED_LATENCY_SET_COLOR_SEQUENCE,start,ret);
+    }
+    ret = led_stageColorSequence(id,steps,n);
+    if (LED_ERR_NONE != ret)
+    {
+        led_abortUpdate(id);
+        return led_latency_return(LED_LATENCY_SET_COLOR_SEQUENCE,start,ret);
+    }
+
+    return led_latency_return(LED_LATENCY_SET_COLOR_SEQUENCE,start,led_txn_commit(id,0));
+}
+
+ledError_t led_setBlinkSequence(ledId_t id, uint32_t ontime, uint32_t offtime1, uint32_t count, uint32_t offtime2)
+{
+    uint64_t start = led_latency_now();
+    ledError_t ret = LED_ERR_NONE;
+
+    LEDMGR_LOG_DEBUG(" %s id: %d ontime: %d offtime1: %d count: %d offtime2: %d\n",__FUNCTION__, id, ontime, offtime1, count, offtime2);
+
+    ret = led_beginUpdate(id);
+    if (LED_ERR_NONE != ret)
+    {
+        return led_latency_return(LED_LATENCY_SET_BLINK_SEQUENCE,start,ret);
+    }
+    led_stageBlinkSequence(id,ontime,offtime1,count,offtime2);
+
+    return led_latency_return(LED_LATENCY_SET_BLINK_SEQUENCE,start,led_txn_commit(id,0));
+}
+
+ledError_t led_setOnOff(ledId_t id, const char* onoff)
+{
+    uint64_t start = led_latency_now();
+    ledError_t ret = LED_ERR_NONE;
+
+    LEDMGR_LOG_DEBUG(" %s id: %d onoff: %s \n",__FUNCTION__, id, onoff);
+
+    ret = led_beginUpdate(id);
+    if (LED_ERR_NONE != ret)
+    {
+        return led_latency_return(LED_LATENCY_SET_ONOFF,start,ret);
+    }
+    ret = led_stageOnOff(id,onoff);
+    if (LED_ERR_NONE != ret)
+    {
+        led_abortUpdate(id);
+        return led_latency_return(LED_LATENCY_SET_ONOFF,start,ret);
+    }
+
+    return led_latency_return(LED_LATENCY_SET_ONOFF,start,led_txn_commit(id,0));
+}
+
+/**
+ * @brief sysfs attributes written by the HAL
+ * LED_SYSFS_LP5562_FW_LOADING and LED_SYSFS_LP5562_FW_DATA belong to the firmware request the lp5562
+ * driver creates when an engine is selected, the driver removes them again once loading has finished.
+*/
+typedef enum Led_Sysfs_Attr {
+    LED_SYSFS_LP5562_RUN_ENGINE = 0,
+    LED_SYSFS_LP5562_SELECT_ENGINE,
+    LED_SYSFS_LP5562_ENGINE_MUX,
+    LED_SYSFS_LP5562_FW_LOADING,
+    LED_SYSFS_LP5562_FW_DATA,
+    LED_SYSFS_AW210XX_RGBCOLOR,
+    LED_SYSFS_AW210XX_REG,
+    LED_SYSFS_IRLED_BRIGHTNESS,
+    LED_SYSFS_ATTR_MAX
+}Led_Sysfs_Attr;
+
+/**
+ * @brief sysfs attribute file
+ * @member variable path       : path of the attribute
+ * @member variable persistent : 1 -- keep fd open between writes, 0 -- node is recreated by the driver, reopen it for every write
+ * @member variable try_times  : open attempts before giving up, 5ms apart
+ * @member variable fd         : cached file descriptor, -1 if not opened
+*/
+typedef struct Led_Sysfs_File{
+    const char *path;
+    int persistent;
+    int try_times;
+    int fd;
+}Led_Sysfs_File;
+
+static Led_Sysfs_File led_sysfs_file[LED_SYSFS_ATTR_MAX] = {
+    {LED_LP5562_DEVICE_PATH "/run_engine", 1, 3, -1},
+    {LED_LP5562_DEVICE_PATH "/select_engine", 1, 3, -1},
+    {LED_LP5562_DEVICE_PATH "/engine_mux", 1, 3, -1},
+    //firmware request is created asynchronously after select_engine, give it up to 100ms to show up
+    {LED_LP5562_DEVICE_PATH "/firmware/lp5562/loading", 0, 20, -1},
+    {LED_LP5562_DEVICE_PATH "/firmware/lp5562/data", 0, 20, -1},
+    {RGBCOLOR, 1, 3, -1},
+    {REG, 1, 3, -1},
+    {LED_IRLED_BRIGHTNESS_FILE, 1, 3, -1},
+};
+
+/**
+ * @brief Open a sysfs attribute.
+ * This function returns the cached fd of the attribute, opening it first if needed.
+ *
+ * @param [in]  attr :  sysfs attribute.
+ * @param [out]      :  None.
+ *
+ * @return           :  fd of the attribute, -1 failed.
+ */
+static int led_sysfs_open(Led_Sysfs_Attr attr)
+{
+    Led_Sysfs_File *file = &led_sysfs_file[attr];
+    char path[LED_PATH_MAX_LENGTH] = {0};
+    int try_times = file->try_times;
+
+    if (file->fd >= 0)
+    {
+        return file->fd;
+    }
+
+    do
+    {
+        file->fd = open(led_path(file->path,path),O_WRONLY|O_CLOEXEC);
+        if (file->fd < 0)
+        {
+            __atomic_add_fetch(&led_stats()->open_retries,1,__ATOMIC_RELAXED);
+            usleep(LED_SYSFS_OPEN_RETRY_INTERVAL);
+        }
+        try_times--;
+    }while((file->fd < 0) && (try_times > 0));
+
+    if (file->fd < 0)
+    {
+        LEDMGR_LOG_ERROR("open %s error: %s\n", led_path(file->path,path), strerror(errno));
+    }
+
+    return file->fd;
+}
+
+/**
+ * @brief Close a sysfs attribute.
+ *
+ * @param [in]  attr :  sysfs attribute.
+ * @param [out]      :  None.
+ *
+ * @return           :  None.
+ */
+static void led_sysfs_close(Led_Sysfs_Attr attr)
+{
+    if (led_sysfs_file[attr].fd >= 0)
+    {
+        close(led_sysfs_file[attr].fd);
+        led_sysfs_file[attr].fd = -1;
+    }
+}
+
+/**
+ * @brief Write a value to a sysfs attribute.
+ * The value is terminated with a newline the same way /bin/echo does, some drivers (lp5562 firmware data)
+ * depend on it. The whole value is written with a single pwrite at offset 0, so a persistent fd can be reused.
+ *
+ * @param [in]  attr  :  sysfs attribute.
+ * @param [in]  value :  value to write.
+ * @param [out]       :  None.
+ *
+ * @return            :  0 success, other value failed.
+ */
+static int led_sysfs_write(Led_Sysfs_Attr attr, const char *value)
+{
+    char buf[LED_SYSFS_WRITE_MAX_LENGTH] = {0};
+    int len = 0;
+    int fd = -1;
+    ssize_t ret = -1;
+
+    len = snprintf(buf,sizeof(buf),"%s\n",value);
+    if ((len < 0) || (len >= (int)sizeof(buf)))
+    {
+        LEDMGR_LOG_ERROR("value for %s is too long\n", led_sysfs_file[attr].path);
+        return -1;
+    }
+
+    fd = led_sysfs_open(attr);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    do
+    {
+        ret = pwrite(fd,buf,len,0);
+    }while((-1 == ret) && (EINTR == errno));
+
+    if (len != ret)
+    {
+        LEDMGR_LOG_ERROR("write \"%s\" to %s error: %s\n", value, led_sysfs_file[attr].path, (-1 == ret) ? strerror(errno) : "short write");
+        //drop the fd, the node may have been recreated by the driver
+        led_sysfs_close(attr);
+        return -1;
+    }
+
+    if (!led_sysfs_file[attr].persistent)
+    {
+        led_sysfs_close(attr);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief IR LED brightness ramp
+ * Ramps are run by a thread of the process which applied them, it writes the brightness every
+ * LED_IRLED_RAMP_STEP_TIME on a timerfd. All members are guarded by the hardware image lock.
+ * @member variable timer_fd   : one-shot timer, expires at the next step
+ * @member variable generation : Led_Hw_Image irled_generation of the ramp, the ramp stops once another apply happened
+ * @member variable running    : 1 -- a ramp is running
+ * @member variable from       : brightness at the start of the ramp
+ * @member variable to         : brightness at the end of the ramp
+ * @member variable start      : CLOCK_MONOTONIC time the ramp started
+ * @member variable duration   : time of the ramp in ms
+*/
+typedef struct Led_IRLED_Ramp{
+    int timer_fd;
+    uint32_t generation;
+    int running;
+    int from;
+    int to;
+    struct timespec start;
+    uint32_t duration;
+}Led_IRLED_Ramp;
+
+static Led_IRLED_Ramp led_irled_ramp = {-1, 0, 0, 0, 0, {0, 0}, 0};
+static pthread_once_t led_irled_ramp_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Read the IR LED brightness.
+ * Used to start a ramp from what the IR LED shows when no apply of this HAL wrote it yet.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  hw :  pointer of LED hardware image.
+ * @param [out]    :  None.
+ *
+ * @return         :  0 success, other value failed.
+ */
+static int led_irled_read(Led_Hw_Image *hw)
+{
+    char path[LED_PATH_MAX_LENGTH] = {0};
+    char buf[LED_IRLED_BRIGHTNESS_LEN] = {0};
+    int fd = -1;
+    int ret = -1;
+
+    fd = open(led_path(LED_IRLED_BRIGHTNESS_FILE,path),O_RDONLY|O_CLOEXEC);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    ret = read(fd,buf,sizeof(buf)-1);
+    close(fd);
+    if (ret <= 0)
+    {
+        return -1;
+    }
+
+    hw->irled_level = atoi(buf);
+    hw->irled_valid = 1;
+
+    return 0;
+}
+
+/**
+ * @brief Write a brightness to the IR LED.
+ * Nothing is written if the IR LED already shows the brightness, so ramp steps which round
+ * to the same brightness cost nothing. Must be called with the hardware image locked.
+ *
+ * @param [in]  hw    :  pointer of LED hardware image.
+ * @param [in]  level :  brightness, 0~255.
+ * @param [out]       :  None.
+ *
+ * @return            :  0 success, other value failed.
+ */
+static int led_irled_write(Led_Hw_Image *hw, int level)
+{
+    char buf[LED_IRLED_BRIGHTNESS_LEN] = {0};
+
+    if (hw->irled_valid && (hw->irled_level == level))
+    {
+        __atomic_add_fetch(&led_stats()->writes_avoided,1,__ATOMIC_RELAXED);
+        return 0;
+    }
+    hw->irled_valid = 0;
+
+    snprintf(buf,sizeof(buf),"%d",level);
+    if (led_sysfs_write(LED_SYSFS_IRLED_BRIGHTNESS,buf))
+    {
+        return -1;
+    }
+    hw->irled_level = level;
+    hw->irled_valid = 1;
+
+    return 0;
+}
+
+/**
+ * @brief Arm the IR LED ramp timer.
+ *
+ * @param [in]  duration :  time until expiry in ms, 0 disarms the timer.
+ * @param [out]          :  None.
+ *
+ * @return               :  0 success, other value failed.
+ */
+static int led_irled_ramp_arm(uint32_t duration)
+{
+    struct itimerspec timer;
+
+    memset(&timer,0,sizeof(timer));
+    timer.it_value.tv_sec = duration / 1000;
+    timer.it_value.tv_nsec = (duration % 1000) * 1000000;
+
+    return timerfd_settime(led_irled_ramp.timer_fd,0,&timer,NULL);
+}
+
+/**
+ * @brief Write the brightness the IR LED ramp has reached and arm the timer for the next step.
+ * The brightness follows the time elapsed since the start, so a late step catches up instead of stretching the ramp.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  hw :  pointer of LED hardware image.
+ * @param [out]    :  None.
+ *
+ * @return         :  0 success, other value failed.
+ */
+static int led_irled_ramp_step(Led_Hw_Image *hw)
+{
+    Led_IRLED_Ramp *ramp = &led_irled_ramp;
+    struct timespec now;
+    int64_t elapsed = 0;
+    int level = ramp->to;
+
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    elapsed = (int64_t)(now.tv_sec - ramp->start.tv_sec) * 1000 + (now.tv_nsec - ramp->start.tv_nsec) / 1000000;
+    if (elapsed < ramp->duration)
+    {
+        level = ramp->from + (int)((ramp->to - ramp->from) * elapsed / (int64_t)ramp->duration);
+    }
+
+    if (led_irled_write(hw,level) || (level == ramp->to))
+    {
+        ramp->running = 0;
+        hw->irled_ramp = 0;
+        return (level == ramp->to) ? 0 : -1;
+    }
+
+    return led_irled_ramp_arm(LED_IRLED_RAMP_STEP_TIME);
+}
+
+/**
+ * @brief IR LED ramp thread.
+ * Waits for the ramp timer and steps the ramp.
+ *
+ * @param [in]  arg :  None.
+ * @param [out]     :  None.
+ *
+ * @return          :  None.
+ */
+static void* led_irled_ramp_thread(void *arg)
+{
+    Led_IRLED_Ramp *ramp = &led_irled_ramp;
+    Led_Hw_Image *hw = NULL;
+    struct itimerspec timer;
+    uint64_t expirations = 0;
+
+    (void)arg;
+    while (1)
+    {
+        if (sizeof(expirations) != read(ramp->timer_fd,&expirations,sizeof(expirations)))
+        {
+            if (EINTR != errno)
+            {
+                LEDMGR_LOG_ERROR("read IR LED ramp timer error: %s\n", strerror(errno));
+                usleep(LED_SYSFS_OPEN_RETRY_INTERVAL);
+            }
+            continue;
+        }
+
+        hw = led_hw_lock(LED_HW_IRLED);
+        //an apply may have re-armed the timer while this thread waited for the lock
+        if ((0 == timerfd_gettime(ramp->timer_fd,&timer)) && !timer.it_value.tv_sec && !timer.it_value.tv_nsec)
+        {
+            if (ramp->running && (ramp->generation == hw->irled_generation))
+            {
+                led_irled_ramp_step(hw);
+            }
+            else
+            {
+                //led has been set by another apply, possibly from another process
+                ramp->running = 0;
+            }
+        }
+        led_hw_unlock(hw,LED_HW_IRLED);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Start the IR LED ramp thread.
+ *
+ * @param [in]  :  None.
+ * @param [out] :  None.
+ *
+ * @return      :  None.
+ */
+static void led_irled_ramp_init(void)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    led_irled_ramp.timer_fd = timerfd_create(CLOCK_MONOTONIC,TFD_CLOEXEC);
+    if (led_irled_ramp.timer_fd < 0)
+    {
+        LEDMGR_LOG_ERROR("create IR LED ramp timer error: %s\n", strerror(errno));
+        return;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread,&attr,led_irled_ramp_thread,NULL))
+    {
+        LEDMGR_LOG_ERROR("create IR LED ramp thread error\n");
+        close(led_irled_ramp.timer_fd);
+        led_irled_ramp.timer_fd = -1;
+    }
+    pthread_attr_destroy(&attr);
+}
+
+/**
+ * @brief Start a ramp of the IR LED from the brightness it shows to a new one.
+ * Must be called with the hardware image locked, and the IR LED brightness known.
+ *
+ * @param [in]  hw       :  pointer of LED hardware image.
+ * @param [in]  level    :  brightness at the end of the ramp, 0~255.
+ * @param [in]  duration :  time of the ramp in ms.
+ * @param [out]          :  None.
+ *
+ * @return               :  0 success, other value failed.
+ */
+static int led_irled_ramp_start(Led_Hw_Image *hw, int level, uint32_t duration)
+{
+    Led_IRLED_Ramp *ramp = &led_irled_ramp;
+
+    pthread_once(&led_irled_ramp_once,led_irled_ramp_init);
+    if (ramp->timer_fd < 0)
+    {
+        return -1;
+    }
+
+    ramp->generation = hw->irled_generation;
+    ramp->from = hw->irled_level;
+    ramp->to = level;
+    ramp->duration = duration;
+    clock_gettime(CLOCK_MONOTONIC,&ramp->start);
+    if (led_irled_ramp_arm(LED_IRLED_RAMP_STEP_TIME))
+    {
+        return -1;
+    }
+    ramp->running = 1;
+    hw->irled_ramp = 1;
+    hw->irled_pid = getpid();
+
+    return 0;
+}
+
+/**
+ * @brief Stop a ramp of the IR LED run by this process.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  :  None.
+ * @param [out] :  None.
+ *
+ * @return      :  None.
+ */
+static void led_irled_ramp_stop(void)
+{
+    if (led_irled_ramp.running)
+    {
+        led_irled_ramp.running = 0;
+        led_irled_ramp_arm(0);
+    }
+}
+
+/**
+ * @brief Apply LED config to IR LED.
+ * The IR LED ramps from the brightness it shows to the new one over the ramp time of the config,
+ * nothing is written if it already shows or ramps to the brightness.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  hw         :  pointer of LED hardware image.
+ * @param [in]  id         :  Identifier of a led.
+ * @param [in]  led_config :  pointer of LED config.
+ * @param [out]            :  None.
+ *
+ * @return                 :  0 success, other value failed.
+ */
+static int led_apply_irled_setting(Led_Hw_Image *hw, ledId_t id, Led_Config *led_config)
+{
+    int level = (Led_ON == led_config->action.act_type) ? led_config->led_irled.brightness : 0;
+    int ramping = 0;
+
+    (void)id;
+    if (hw->irled_ramp)
+    {
+        ramping = (getpid() == hw->irled_pid) ? led_irled_ramp.running : (0 == kill(hw->irled_pid,0));
+    }
+    if (hw->irled_valid && (hw->irled_target == level) && (ramping || (hw->irled_level == level)))
+    {
+        __atomic_add_fetch(&led_stats()->apply_noops,1,__ATOMIC_RELAXED);
+        __atomic_add_fetch(&led_stats()->writes_avoided,1,__ATOMIC_RELAXED);
+        return 0;
+    }
+
+    //stops any ramp, in this or another process
+    hw->irled_generation++;
+    hw->irled_ramp = 0;
+    led_irled_ramp_stop();
+    hw->irled_target = level;
+
+    if (!hw->irled_valid)
+    {
+        led_irled_read(hw);
+    }
+    if (led_config->led_irled.ramp_time && hw->irled_valid && (hw->irled_level != level) &&
+        (0 == led_irled_ramp_start(hw,level,led_config->led_irled.ramp_time)))
+    {
+        return 0;
+    }
+
+    return led_irled_write(hw,level);
+}
+
+/**
+ * @brief Encode LP5562 set_pwm instruction.
+ *
+ * @param [in]  pwm :  pwm of the channel, 0~255.
+ *
+ * @return          :  instruction.
+ */
+static inline uint16_t led_lp5562_set_pwm(uint8_t pwm)
+{
+    return LED_LP5562_SET_PWM_CMD | pwm;
+}
+
+/**
+ * @brief Encode LP5562 wait instruction, with 15.6ms prescale.
+ *
+ * @param [in]  steps :  wait time in steps of 15.6ms, 1~63.
+ *
+ * @return            :  instruction.
+ */
+static inline uint16_t led_lp5562_wait(uint16_t steps)
+{
+    return (LED_LP5562_WAIT_CMD_PRESCALE | steps) << 8;
+}
+
+/**
+ * @brief Encode LP5562 ramp instruction.
+ * The pwm of the channel is changed by 1 every step time, increment times.
+ *
+ * @param [in]  slow      :  1 -- step time in 15.6ms, 0 -- step time in 0.49ms.
+ * @param [in]  steps     :  step time, 1~63.
+ * @param [in]  decrease  :  1 -- decrease pwm, 0 -- increase pwm.
+ * @param [in]  increment :  number of steps, 1~127.
+ *
+ * @return                :  instruction.
+ */
+static inline uint16_t led_lp5562_ramp(int slow, uint16_t steps, int decrease, uint16_t increment)
+{
+    return (((slow ? LED_LP5562_WAIT_CMD_PRESCALE : 0) | steps) << 8) | (decrease ? LED_LP5562_RAMP_CMD_DECREASE : 0) | increment;
+}
+
+/**
+ * @brief Encode LP5562 branch instruction.
+ *
+ * @param [in]  loop_count :  times to jump back, 0 -- jump back forever.
+ * @param [in]  step       :  instruction index to jump to.
+ *
+ * @return                 :  instruction.
+ */
+static inline uint16_t led_lp5562_branch(uint16_t loop_count, uint16_t step)
+{
+    return LED_LP5562_BRANCH_CMD | (loop_count << 7) | step;
+}
+
+/**
+ * @brief Encode LP5562 end instruction.
+ *
+ * @return :  instruction.
+ */
+static inline uint16_t led_lp5562_end(void)
+{
+    return LED_LP5562_END_CMD;
+}
+
+/**
+ * @brief Append an instruction to the program of an engine.
+ * Instructions beyond the engine's program memory are dropped.
+ *
+ * @param [in]  program     :  pointer of LP5562 program.
+ * @param [in]  engine      :  engine, 0~2.
+ * @param [in]  instruction :  instruction to append.
+ *
+ * @return                  :  None.
+ */
+static void led_lp5562_emit(Led_LP5562_Program *program, int engine, uint16_t instruction)
+{
+    if (program->length[engine] < LED_LP5562_ENGINE_MAX_INSTRUCTIONS)
+    {
+        program->instruction[engine][program->length[engine]++] = instruction;
+    }
+    else
+    {
+        LEDMGR_LOG_ERROR("engine %d program is longer than %d instructions\n", engine+1, LED_LP5562_ENGINE_MAX_INSTRUCTIONS);
+    }
+}
+
+/**
+ * @brief Append the waits for a time to the program of an engine.
+ * Waits longer than one wait instruction are looped with a branch.
+ *
+ * @param [in]  program :  pointer of LP5562 program.
+ * @param [in]  engine  :  engine, 0~2.
+ * @param [in]  time    :  time in ms.
+ *
+ * @return              :  None.
+ */
+static void led_lp5562_emit_wait_for(Led_LP5562_Program *program, int engine, uint32_t time)
+{
+    uint16_t loop_time = (time*10) / (LED_LP5562_WAIT_CMD_MAX_STEP * LED_LP5562_WAIT_CMD_STEP_TIME);
+    uint16_t remainder_step = ((time*10) % (LED_LP5562_WAIT_CMD_MAX_STEP * LED_LP5562_WAIT_CMD_STEP_TIME)) / LED_LP5562_WAIT_CMD_STEP_TIME;
+
+    if (loop_time > 0)
+    {
+        //wait
+        led_lp5562_emit(program,engine,led_lp5562_wait(LED_LP5562_WAIT_CMD_MAX_STEP));
+        if (loop_time > 1)
+        {
+            //loop the wait just emitted
+            led_lp5562_emit(program,engine,led_lp5562_branch(loop_time - 1,program->length[engine] - 1));
+        }
+    }
+    if (remainder_step > 0)
+    {
+        led_lp5562_emit(program,engine,led_lp5562_wait(remainder_step));
+    }
+}
+
+/**
+ * @brief Append set_pwm followed by the waits for a time to the program of an engine.
+ *
+ * @param [in]  program :  pointer of LP5562 program.
+ * @param [in]  engine  :  engine, 0~2.
+ * @param [in]  pwm     :  pwm of the channel, 0~255.
+ * @param [in]  time    :  time in ms.
+ *
+ * @return              :  None.
+ */
+static void led_lp5562_emit_pwm_for(Led_LP5562_Program *program, int engine, uint8_t pwm, uint32_t time)
+{
+    led_lp5562_emit(program,engine,led_lp5562_set_pwm(pwm));
+    led_lp5562_emit_wait_for(program,engine,time);
+}
+
+/**
+ * @brief Append the ramps of the pwm of a channel from one value to another over a time to the program of an engine.
+ * The ramp step time is the time divided by the pwm change, rounded to what LP5562 supports, from 0.49ms to 982ms.
+ * The engine must hold the pwm to ramp from.
+ *
+ * @param [in]  program :  pointer of LP5562 program.
+ * @param [in]  engine  :  engine, 0~2.
+ * @param [in]  from    :  pwm at the start of the ramp, 0~255.
+ * @param [in]  to      :  pwm at the end of the ramp, 0~255.
+ * @param [in]  time    :  time in ms.
+ *
+ * @return              :  None.
+ */
+static void led_lp5562_emit_ramp(Led_LP5562_Program *program, int engine, uint8_t from, uint8_t to, uint32_t time)
+{
+    uint32_t increment = (to > from) ? (to - from) : (from - to);
+    uint32_t step_time = 0;
+    uint32_t steps = 0;
+    uint32_t count = 0;
+    int slow = 0;
+
+    if (0 == increment)
+    {
+        //nothing to ramp, hold the pwm for the time
+        led_lp5562_emit_wait_for(program,engine,time);
+        return;
+    }
+
+    step_time = (uint32_t)(((uint64_t)time * 1000) / increment);
+    slow = (step_time > (LED_LP5562_RAMP_CMD_MAX_STEP * LED_LP5562_RAMP_CMD_FAST_STEP_TIME));
+    steps = (step_time + (slow ? LED_LP5562_RAMP_CMD_SLOW_STEP_TIME : LED_LP5562_RAMP_CMD_FAST_STEP_TIME) / 2) /
+            (slow ? LED_LP5562_RAMP_CMD_SLOW_STEP_TIME : LED_LP5562_RAMP_CMD_FAST_STEP_TIME);
+    steps = (steps < 1) ? 1 : ((steps > LED_LP5562_RAMP_CMD_MAX_STEP) ? LED_LP5562_RAMP_CMD_MAX_STEP : steps);
+
+    while (increment > 0)
+    {
+        count = (increment > LED_LP5562_RAMP_CMD_MAX_INCREMENT) ? LED_LP5562_RAMP_CMD_MAX_INCREMENT : increment;
+        led_lp5562_emit(program,engine,led_lp5562_ramp(slow,(uint16_t)steps,(to < from),(uint16_t)count));
+        increment -= count;
+    }
+}
+
+/**
+ * @brief Append an instruction of a pattern to the program of an engine.
+ * Instructions are counted even when they do not fit, so the size of a pattern can be checked.
+ *
+ * @param [in]  program     :  pointer of LP5562 program.
+ * @param [in]  engine      :  engine, 0~2.
+ * @param [in]  instruction :  instruction to append.
+ * @param [in]  needed      :  instructions of the pattern so far.
+ * @param [out] needed      :  instructions of the pattern including this one.
+ *
+ * @return                  :  None.
+ */
+static void led_lp5562_pattern_emit(Led_LP5562_Program *program, int engine, uint16_t instruction, int *needed)
+{
+    (*needed)++;
+    if (*needed <= LED_LP5562_ENGINE_MAX_INSTRUCTIONS)
+    {
+        led_lp5562_emit(program,engine,instruction);
+    }
+}
+
+/**
+ * @brief Append set_pwm followed by the waits for a number of wait steps to a pattern.
+ *
+ * @param [in]  program :  pointer of LP5562 program.
+ * @param [in]  engine  :  engine, 0~2.
+ * @param [in]  pwm     :  pwm of the channel, 0~255.
+ * @param [in]  steps   :  wait steps of 15.6ms.
+ * @param [in]  needed  :  instructions of the pattern so far.
+ * @param [out] needed  :  instructions of the pattern including these.
+ *
+ * @return              :  None.
+ */
+static void led_lp5562_pattern_emit_run(Led_LP5562_Program *program, int engine, uint8_t pwm, uint32_t steps, int *needed)
+{
+    uint32_t loop_time = steps / LED_LP5562_WAIT_CMD_MAX_STEP;
+
+    led_lp5562_pattern_emit(program,engine,led_lp5562_set_pwm(pwm),needed);
+    if (loop_time > 0)
+    {
+        led_lp5562_pattern_emit(program,engine,led_lp5562_wait(LED_LP5562_WAIT_CMD_MAX_STEP),needed);
+        if (loop_time > 1)
+        {
+            //loop the wait just emitted
+            led_lp5562_pattern_emit(program,engine,led_lp5562_branch((uint16_t)(loop_time - 1),(uint16_t)(*needed - 1)),needed);
+        }
+    }
+    if (steps % LED_LP5562_WAIT_CMD_MAX_STEP)
+    {
+        led_lp5562_pattern_emit(program,engine,led_lp5562_wait((uint16_t)(steps % LED_LP5562_WAIT_CMD_MAX_STEP)),needed);
+    }
+}
+
+/**
+ * @brief Compile a pattern for the program of an engine.
+ * Step times are rounded down to 15.6ms, steps with the same pwm are merged, and a sequence of steps
+ * repeated back to back is emitted once and looped with a branch. Loops are never nested, a looped
+ * sequence only holds steps short enough to need no loop of their own. The program repeats forever.
+ *
+ * @param [in]  pattern :  pointer of the pattern.
+ * @param [in]  engine  :  engine, 0~2.
+ * @param [out] program :  pointer of LP5562 program, gets the instructions which fit.
+ *
+ * @return              :  instructions the pattern needs, the pattern does not fit if more than LED_LP5562_ENGINE_MAX_INSTRUCTIONS.
+ */
+static int led_lp5562_compile_pattern(const Led_Pattern *pattern, int engine, Led_LP5562_Program *program)
+{
+    uint8_t pwm[LED_PATTERN_MAX_STEPS] = {0};
+    uint32_t steps[LED_PATTERN_MAX_STEPS] = {0};
+    uint32_t step_count = 0;
+    int count = 0;
+    int needed = 0;
+    int best_len = 0;
+    int best_repeat = 0;
+    int best_saving = 0;
+    int block_cost = 0;
+    int repeat = 0;
+    int start = 0;
+    int len = 0;
+    int i = 0;
+    int j = 0;
+
+    //merge steps with the same pwm
+    for (i = 0; (i < (int)pattern->count) && (i < LED_PATTERN_MAX_STEPS); i++)
+    {
+        step_count = (pattern->step[i].duration * 10) / LED_LP5562_WAIT_CMD_STEP_TIME;
+        if (0 == step_count)
+        {
+            continue;
+        }
+        if (count && (pwm[count-1] == pattern->step[i].pwm[engine]))
+        {
+            steps[count-1] += step_count;
+        }
+        else
+        {
+            pwm[count] = pattern->step[i].pwm[engine];
+            steps[count] = step_count;
+            count++;
+        }
+    }
+
+    i = 0;
+    while (i < count)
+    {
+        //find the repeated sequence starting here that saves the most instructions
+        best_len = 0;
+        best_saving = 0;
+        for (len = 1; (i + 2*len) <= count; len++)
+        {
+            block_cost = 0;
+            for (j = i; j < (i + len); j++)
+            {
+                if (steps[j] > LED_LP5562_WAIT_CMD_MAX_STEP * 2 - 1)
+                {
+                    break;
+                }
+                block_cost += 1 + (int)(steps[j] / LED_LP5562_WAIT_CMD_MAX_STEP) + ((steps[j] % LED_LP5562_WAIT_CMD_MAX_STEP) ? 1 : 0);
+            }
+            if (j < (i + len))
+            {
+                //a step needs a loop of its own, no longer sequence can be looped either
+                break;
+            }
+            for (repeat = 1; (i + (repeat+1)*len <= count) && (repeat <= LED_LP5562_BRANCH_CMD_MAX_LOOP); repeat++)
+            {
+                if (memcmp(&pwm[i],&pwm[i + repeat*len],len) || memcmp(&steps[i],&steps[i + repeat*len],len*sizeof(steps[0])))
+                {
+                    break;
+                }
+            }
+            if ((repeat > 1) && (((repeat - 1) * block_cost - 1) > best_saving))
+            {
+                best_len = len;
+                best_repeat = repeat;
+                best_saving = (repeat - 1) * block_cost - 1;
+            }
+        }
+
+        if (best_len)
+        {
+            start = needed;
+            for (j = i; j < (i + best_len); j++)
+            {
+                led_lp5562_pattern_emit_run(program,engine,pwm[j],steps[j],&needed);
+            }
+            led_lp5562_pattern_emit(program,engine,led_lp5562_branch((uint16_t)(best_repeat - 1),(uint16_t)start),&needed);
+            i += best_len * best_repeat;
+        }
+        else
+        {
+            led_lp5562_pattern_emit_run(program,engine,pwm[i],steps[i],&needed);
+            i++;
+        }
+    }
+
+    //goto start
+    led_lp5562_pattern_emit(program,engine,led_lp5562_branch(0,0),&needed);
+
+    return needed;
+}
+
+/**
+ * @brief Check a pattern can be run.
+ * The steps must be longer than 15.6ms in total, and the pattern of every channel must fit in an engine.
+ *
+ * @param [in]  pattern :  pointer of the pattern.
+ * @param [out]         :  None.
+ *
+ * @return Error Code   :  If error code is returned then the pattern can not be run.
+ */
+static ledError_t led_validate_pattern(const Led_Pattern *pattern)
+{
+    uint32_t max_time = LED_LP5562_WAIT_CMD_STEP_TIME * LED_LP5562_WAIT_CMD_MAX_STEP * LED_LP5562_BRANCH_CMD_MAX_LOOP;
+    Led_LP5562_Program program;
+    uint32_t total = 0;
+    uint32_t i = 0;
+    int needed = 0;
+    int engine = 0;
+
+    if ((0 == pattern->count) || (pattern->count > LED_PATTERN_MAX_STEPS))
+    {
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] pattern of %d steps is illegal\n",__FUNCTION__,__LINE__,pattern->count);
+        return LED_ERR_INVALID_PARAM;
+    }
+    for (i = 0; i < pattern->count; i++)
+    {
+        if ((pattern->step[i].duration*10) > max_time)
+        {
+            snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] step %d time value %d is illegal\n",__FUNCTION__,__LINE__,i,pattern->step[i].duration);
+            return LED_ERR_INVALID_PARAM;
+        }
+        total += (pattern->step[i].duration*10) / LED_LP5562_WAIT_CMD_STEP_TIME;
+    }
+    if (0 == total)
+    {
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] pattern is shorter than one wait step\n",__FUNCTION__,__LINE__);
+        return LED_ERR_INVALID_PARAM;
+    }
+
+    for (engine = 0; engine < 3; engine++)
+    {
+        memset(&program,0,sizeof(program));
+        needed = led_lp5562_compile_pattern(pattern,engine,&program);
+        if (needed > LED_LP5562_ENGINE_MAX_INSTRUCTIONS)
+        {
+            snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] pattern needs %d instructions for channel %d, max %d\n",__FUNCTION__,__LINE__,needed,engine,LED_LP5562_ENGINE_MAX_INSTRUCTIONS);
+            return LED_ERR_INVALID_PARAM;
+        }
+    }
+
+    return LED_ERR_NONE;
+}
+
+static void led_transfer_command_to_lp5562_program(Led_Config *led_config, Led_LP5562_Program *program)
+{
+    int index = 0;
+
+    memset(program,0,sizeof(Led_LP5562_Program));
+
+    for (index = 0; index < 3; index++)
+    {
+        if (Led_PATTERN == led_config->action.act_type)
+        {
+            //validated to fit, the program loops forever and needs no end
+            led_lp5562_compile_pattern(&led_config->action.pattern,index,program);
+            continue;
+        }
+        if (Led_BLINK == led_config->action.act_type)
+        {
+            //turn on, turn off
+            led_lp5562_emit_pwm_for(program,index,led_config->led_chip.channel[index].pwm,led_config->action.on_time);
+            led_lp5562_emit_pwm_for(program,index,0,led_config->action.off_time);
+            //goto start
+            led_lp5562_emit(program,index,led_lp5562_branch(0,0));
+        }
+        else if (Led_SEQ_BLINK == led_config->action.act_type)
+        {
+            //turn on, turn off1
+            led_lp5562_emit_pwm_for(program,index,led_config->led_chip.channel[index].pwm,led_config->action.on_time);
+            led_lp5562_emit_pwm_for(program,index,0,led_config->action.off1_time);
+            //count
+            if (led_config->action.count > 1)
+            {
+                led_lp5562_emit(program,index,led_lp5562_branch((uint16_t)(led_config->action.count - 1),0));
+            }
+            //turn off2
+            led_lp5562_emit_pwm_for(program,index,0,led_config->action.off2_time);
+            //goto start
+            led_lp5562_emit(program,index,led_lp5562_branch(0,0));
+        }
+        else if (Led_FADE_IN == led_config->action.act_type)
+        {
+            //fade from off to on, and stay on
+            led_lp5562_emit(program,index,led_lp5562_set_pwm(0));
+            led_lp5562_emit_ramp(program,index,0,led_config->led_chip.channel[index].pwm,led_config->action.on_time);
+        }
+        else if (Led_FADE_OUT == led_config->action.act_type)
+        {
+            //fade from on to off, and stay off
+            led_lp5562_emit(program,index,led_lp5562_set_pwm(led_config->led_chip.channel[index].pwm));
+            led_lp5562_emit_ramp(program,index,led_config->led_chip.channel[index].pwm,0,led_config->action.off_time);
+        }
+        else if (Led_BREATHE == led_config->action.act_type)
+        {
+            //fade in, fade out
+            led_lp5562_emit(program,index,led_lp5562_set_pwm(0));
+            led_lp5562_emit_ramp(program,index,0,led_config->led_chip.channel[index].pwm,led_config->action.on_time);
+            led_lp5562_emit_ramp(program,index,led_config->led_chip.channel[index].pwm,0,led_config->action.off_time);
+            //goto start
+            led_lp5562_emit(program,index,led_lp5562_branch(0,0));
+        }
+        else if (Led_OFF == led_config->action.act_type)
+        {
+            led_lp5562_emit(program,index,led_lp5562_set_pwm(0));
+        }
+        else
+        {
+            led_lp5562_emit(program,index,led_lp5562_set_pwm(led_config->led_chip.channel[index].pwm));
+        }
+        led_lp5562_emit(program,index,led_lp5562_end());
+    }
+}
+
+/**
+ * @brief Format the program of an engine in HEX, as the lp5562 firmware interface expects it.
+ *
+ * @param [in]  program :  pointer of LP5562 program.
+ * @param [in]  engine  :  engine, 0~2.
+ * @param [out] hex     :  program in HEX, LED_LP5562_COMMAND_LEN bytes.
+ *
+ * @return              :  None.
+ */
+static void led_lp5562_program_to_hex(const Led_LP5562_Program *program, int engine, char hex[LED_LP5562_COMMAND_LEN])
+{
+    static const char digit[] = "0123456789ABCDEF";
+    uint16_t instruction = 0;
+    char *p = hex;
+    int i = 0;
+
+    for (i = 0; i < program->length[engine]; i++)
+    {
+        instruction = program->instruction[engine][i];
+        *p++ = digit[(instruction >> 12) & 0xF];
+        *p++ = digit[(instruction >> 8) & 0xF];
+        *p++ = digit[(instruction >> 4) & 0xF];
+        *p++ = digit[instruction & 0xF];
+    }
+    *p = '\0';
+}
+
+//compiled LP5562 programs kept for reuse, the device only cycles through a few states
+#define LED_LP5562_PROGRAM_CACHE_SIZE 8
+
+/**
+ * @brief key of a compiled LP5562 program
+ * Everything led_transfer_command_to_lp5562_program reads from the LED config, fields not used by the action are 0.
+*/
+typedef struct Led_LP5562_Program_Key{
+    Action_Type act_type;
+    uint32_t on_time;
+    uint32_t off_time;
+    uint32_t off1_time;
+    uint32_t count;
+    uint32_t off2_time;
+    uint8_t pwm[3];
+    Led_Pattern pattern;
+}Led_LP5562_Program_Key;
+
+/**
+ * @brief compiled LP5562 program
+ * @member variable used    : last use, for replacement, 0 -- entry is empty
+ * @member variable key     : key of the program
+ * @member variable program : program of every engine
+*/
+typedef struct Led_LP5562_Program_Entry{
+    uint32_t used;
+    Led_LP5562_Program_Key key;
+    Led_LP5562_Program program;
+}Led_LP5562_Program_Entry;
+
+static Led_LP5562_Program_Entry led_lp5562_program_cache[LED_LP5562_PROGRAM_CACHE_SIZE];
+static uint32_t led_lp5562_program_clock = 0;
+static pthread_mutex_t led_lp5562_program_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Get the LP5562 program of a LED config.
+ * The program is taken from the cache if the same action, timings and pwm have been compiled before,
+ * otherwise it is compiled and replaces the least recently used entry.
+ *
+ * @param [in]  led_config :  pointer of LED config.
+ * @param [out] program    :  pointer of LP5562 program.
+ *
+ * @return                 :  None.
+ */
+static void led_get_lp5562_program(Led_Config *led_config, Led_LP5562_Program *program)
+{
+    Led_LP5562_Program_Key key;
+    Led_LP5562_Program_Entry *entry = &led_lp5562_program_cache[0];
+    int index = 0;
+
+    memset(&key,0,sizeof(key));
+    key.act_type = led_config->action.act_type;
+    if ((Led_BLINK == key.act_type) || (Led_FADE_IN == key.act_type) || (Led_FADE_OUT == key.act_type) || (Led_BREATHE == key.act_type))
+    {
+        key.on_time = led_config->action.on_time;
+        key.off_time = led_config->action.off_time;
+    }
+    else if (Led_PATTERN == key.act_type)
+    {
+        memcpy(&key.pattern,&led_config->action.pattern,sizeof(key.pattern));
+    }
+    else if (Led_SEQ_BLINK == key.act_type)
+    {
+        key.on_time = led_config->action.on_time;
+        key.off1_time = led_config->action.off1_time;
+        key.count = led_config->action.count;
+        key.off2_time = led_config->action.off2_time;
+    }
+    if (Led_OFF != key.act_type)
+    {
+        for (index = 0; index < 3; index++)
+        {
+            key.pwm[index] = led_config->led_chip.channel[index].pwm;
+        }
+    }
+
+    pthread_mutex_lock(&led_lp5562_program_mutex);
+    led_lp5562_program_clock++;
+    for (index = 0; index < LED_LP5562_PROGRAM_CACHE_SIZE; index++)
+    {
+        if (led_lp5562_program_cache[index].used && !memcmp(&led_lp5562_program_cache[index].key,&key,sizeof(key)))
+        {
+            led_lp5562_program_cache[index].used = led_lp5562_program_clock;
+            memcpy(program,&led_lp5562_program_cache[index].program,sizeof(Led_LP5562_Program));
+            pthread_mutex_unlock(&led_lp5562_program_mutex);
+            __atomic_add_fetch(&led_stats()->program_cache_hits,1,__ATOMIC_RELAXED);
+            return;
+        }
+        if (led_lp5562_program_cache[index].used < entry->used)
+        {
+            entry = &led_lp5562_program_cache[index];
+        }
+    }
+
+    led_transfer_command_to_lp5562_program(led_config,program);
+    entry->used = led_lp5562_program_clock;
+    memcpy(&entry->key,&key,sizeof(key));
+    memcpy(&entry->program,program,sizeof(Led_LP5562_Program));
+    pthread_mutex_unlock(&led_lp5562_program_mutex);
+    __atomic_add_fetch(&led_stats()->program_cache_misses,1,__ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Load programs to LP5562 engines through the driver's sysfs interface.
+ * Stops the engines, loads every engine's program through the firmware loading interface and runs them again.
+ *
+ * @param [in]  program :  pointer of LP5562 program.
+ * @param [out]         :  None.
+ *
+ * @return              :  0 success, other value failed.
+ */
+static int led_lp5562_load_engines_sysfs(const Led_LP5562_Program *program)
+{
+    char hex[LED_LP5562_COMMAND_LEN] = {0};
+    char engine[4] = {0};
+    int i = 0;
+
+    //firstly stop engine
+    if (led_sysfs_write(LED_SYSFS_LP5562_RUN_ENGINE,"0"))
+    {
+        return -1;
+    }
+    for (i = 0; i < 3; i++)
+    {
+        //select engine
+        snprintf(engine,sizeof(engine),"%d",i+1);
+        if (led_sysfs_write(LED_SYSFS_LP5562_SELECT_ENGINE,engine))
+        {
+            return -1;
+        }
+        //set engine mod
+        if (led_sysfs_write(LED_SYSFS_LP5562_ENGINE_MUX,"RGB"))
+        {
+            return -1;
+        }
+        //loading command
+        if (led_sysfs_write(LED_SYSFS_LP5562_FW_LOADING,"1"))
+        {
+            return -1;
+        }
+        led_lp5562_program_to_hex(program,i,hex);
+        if (led_sysfs_write(LED_SYSFS_LP5562_FW_DATA,hex))
+        {
+            //abort the firmware request, otherwise the driver waits for its timeout
+            led_sysfs_write(LED_SYSFS_LP5562_FW_LOADING,"-1");
+            return -1;
+        }
+        //end loading
+        if (led_sysfs_write(LED_SYSFS_LP5562_FW_LOADING,"0"))
+        {
+            return -1;
+        }
+    }
+    //run engine
+    return led_sysfs_write(LED_SYSFS_LP5562_RUN_ENGINE,"1");
+}
+
+/**
+ * @brief Check LP5562 engines are loaded directly over I2C.
+ * Enabled with LED_OPT_LP5562_I2C_LOAD, or for all processes with LED_LP5562_I2C_LOAD_FILE.
+ *
+ * @param [in]  :  None.
+ * @param [out] :  None.
+ *
+ * @return      :  1 load over I2C, 0 load through sysfs.
+ */
+static int led_lp5562_i2c_load_enabled(void)
+{
+    char path[LED_PATH_MAX_LENGTH] = {0};
+
+    return led_lp5562_i2c_load || (0 == access(led_path(LED_LP5562_I2C_LOAD_FILE,path), F_OK));
+}
+
+/**
+ * @brief Run an I2C transaction on the LP5562.
+ * All messages are sent with a single I2C_RDWR ioctl.
+ *
+ * @param [in]  lp5562_fd :  fd of the I2C bus.
+ * @param [in]  msgs      :  messages of the transaction.
+ * @param [in]  count     :  number of messages.
+ * @param [out]           :  None.
+ *
+ * @return                :  0 success, other value failed.
+ */
+static int led_lp5562_i2c_transfer(int lp5562_fd, struct i2c_msg *msgs, int count)
+{
+    struct i2c_rdwr_ioctl_data data;
+    int ret = -1;
+
+    data.msgs = msgs;
+    data.nmsgs = count;
+    do
+    {
+        ret = ioctl(lp5562_fd, I2C_RDWR, &data);
+    }while((-1 == ret) && (EINTR == errno));
+
+    if (count != ret)
+    {
+        LEDMGR_LOG_ERROR("LP5562 I2C transfer error: %s\n", (-1 == ret) ? strerror(errno) : "short transfer");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Load programs to LP5562 engines directly over I2C.
+ * Halts the engines and puts all of them in load mode, which resets their program counters, writes the program
+ * memory of the engines whose program changed with block writes and runs all engines again from the start.
+ *
+ * @param [in]  lp5562_fd :  fd of the I2C bus.
+ * @param [in]  program   :  pointer of LP5562 program.
+ * @param [in]  loaded    :  pointer of LP5562 program currently in the engines, NULL if unknown.
+ * @param [out]           :  None.
+ *
+ * @return                :  0 success, other value failed.
+ */
+static int led_lp5562_load_engines_i2c(int lp5562_fd, const Led_LP5562_Program *program, const Led_LP5562_Program *loaded)
+{
+    uint8_t memory[3][1 + LED_LP5562_ENGINE_MAX_INSTRUCTIONS*2];
+    uint8_t halt[2][2] = {{LED_LP5562_ENABLE_REG, LED_LP5562_ENABLE_DEFAULT}, {LED_LP5562_OP_MODE_REG, LED_LP5562_OP_MODE_LOAD}};
+    uint8_t run[2][2] = {{LED_LP5562_ENG_SEL_REG, LED_LP5562_ENG_SEL_RGB}, {LED_LP5562_OP_MODE_REG, LED_LP5562_OP_MODE_RUN}};
+    uint8_t enable[2] = {LED_LP5562_ENABLE_REG, LED_LP5562_ENABLE_DEFAULT | LED_LP5562_ENABLE_RUN};
+    struct i2c_msg msgs[5];
+    int count = 0;
+    int engine = 0;
+    int i = 0;
+
+    memset(memory,0,sizeof(memory));
+    memset(msgs,0,sizeof(msgs));
+
+    //halt engines, load mode
+    for (i = 0; i < 2; i++)
+    {
+        msgs[i].addr = LED_LP5562_I2C_ADDR;
+        msgs[i].len = sizeof(halt[i]);
+        msgs[i].buf = halt[i];
+    }
+    if (led_lp5562_i2c_transfer(lp5562_fd,msgs,2))
+    {
+        return -1;
+    }
+    usleep(LED_LP5562_OP_MODE_DELAY);
+
+    //program memory of the changed engines, register address auto increments
+    for (engine = 0; engine < 3; engine++)
+    {
+        if ((NULL != loaded) && (loaded->length[engine] == program->length[engine]) &&
+            !memcmp(loaded->instruction[engine],program->instruction[engine],sizeof(program->instruction[engine])))
+        {
+            continue;
+        }
+        memory[engine][0] = LED_LP5562_PROG_MEM_REG(engine);
+        for (i = 0; i < program->length[engine]; i++)
+        {
+            memory[engine][1 + i*2] = program->instruction[engine][i] >> 8;
+            memory[engine][2 + i*2] = program->instruction[engine][i] & 0xFF;
+        }
+        msgs[count].addr = LED_LP5562_I2C_ADDR;
+        msgs[count].len = sizeof(memory[engine]);
+        msgs[count].buf = memory[engine];
+        count++;
+    }
+    //map R, G, B to engine 1, 2, 3, run mode
+    for (i = 0; i < 2; i++)
+    {
+        msgs[count].addr = LED_LP5562_I2C_ADDR;
+        msgs[count].len = sizeof(run[i]);
+        msgs[count].buf = run[i];
+        count++;
+    }
+    if (led_lp5562_i2c_transfer(lp5562_fd,msgs,count))
+    {
+        return -1;
+    }
+    usleep(LED_LP5562_OP_MODE_DELAY);
+
+    //run engines
+    msgs[0].addr = LED_LP5562_I2C_ADDR;
+    msgs[0].len = sizeof(enable);
+    msgs[0].buf = enable;
+
+    return led_lp5562_i2c_transfer(lp5562_fd,msgs,1);
+}
+
+/**
+ * @brief Load programs to LP5562 engines.
+ * Nothing is loaded if the engines already run the programs. Engines are loaded over I2C if enabled,
+ * falling back to the driver's sysfs interface if that fails.
+ *
+ * @param [in]  engines   :  pointer of programs last loaded into the engines, must be called with the hardware image locked.
+ * @param [in]  lp5562_fd :  fd of the I2C bus.
+ * @param [in]  program   :  pointer of LP5562 program.
+ * @param [out]           :  None.
+ *
+ * @return                :  0 success, other value failed.
+ */
+static int led_lp5562_load_engines(Led_LP5562_Engines *engines, int lp5562_fd, const Led_LP5562_Program *program)
+{
+    Led_LP5562_Program loaded;
+    int loaded_valid = 0;
+    int ret = -1;
+
+    //loading resets all engines, so they are only left alone if no program changed
+    if (engines->valid && !memcmp(&engines->program,program,sizeof(Led_LP5562_Program)))
+    {
+        __atomic_add_fetch(&led_stats()->engine_reload_skips,1,__ATOMIC_RELAXED);
+        return 0;
+    }
+    loaded_valid = engines->valid;
+    memcpy(&loaded,&engines->program,sizeof(Led_LP5562_Program));
+    //engines are in an unknown state until loading has finished
+    engines->valid = 0;
+
+    if (led_lp5562_i2c_load_enabled())
+    {
+        ret = led_lp5562_load_engines_i2c(lp5562_fd,program,loaded_valid ? &loaded : NULL);
+        if (ret)
+        {
+            LEDMGR_LOG_WARN("load LP5562 engines over I2C failed, fall back to sysfs\n");
+        }
+    }
+    if (ret)
+    {
+        ret = led_lp5562_load_engines_sysfs(program);
+    }
+
+    if (!ret)
+    {
+        memcpy(&engines->program,program,sizeof(Led_LP5562_Program));
+        engines->valid = 1;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Open the I2C bus of LP5562.
+ * This function returns the cached fd of the bus, opening and configuring it first if needed.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  :  None.
+ * @param [out] :  None.
+ *
+ * @return      :  fd of the I2C bus, -1 failed.
+ */
+static int led_lp5562_open(void)
+{
+    int try_times = LED_LP5562_I2C_OPEN_RETRY_TIMES;
+    char path[LED_PATH_MAX_LENGTH] = {0};
+    long funcs = 0;
+
+    if (led_lp5562_fd >= 0)
+    {
+        return led_lp5562_fd;
+    }
+
+    do
+    {
+        led_lp5562_fd = open(led_path(LED_LP5562_I2C_DEVICE,path),O_RDWR|O_CLOEXEC);
+        if (led_lp5562_fd < 0)
+        {
+            __atomic_add_fetch(&led_stats()->open_retries,1,__ATOMIC_RELAXED);
+            usleep(5000);
+        }
+        try_times--;
+    }while((led_lp5562_fd < 0) && (try_times > 0));
+
+    if (led_lp5562_fd < 0)
+    {
+        LEDMGR_LOG_ERROR("open  led I2C error\n");
+        return -1;
+    }
+
+    if ((ioctl(led_lp5562_fd, I2C_FUNCS, &funcs) < 0) || !(funcs & I2C_FUNC_I2C) ||
+        (ioctl(led_lp5562_fd, I2C_SLAVE_FORCE, LED_LP5562_I2C_ADDR) < 0))
+    {
+        LEDMGR_LOG_ERROR("configure led I2C error\n");
+        close(led_lp5562_fd);
+        led_lp5562_fd = -1;
+    }
+
+    return led_lp5562_fd;
+}
+
+/**
+ * @brief Close the I2C bus of LP5562, it is opened again by the next apply.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  :  None.
+ * @param [out] :  None.
+ *
+ * @return      :  None.
+ */
+static void led_lp5562_close(void)
+{
+    if (led_lp5562_fd >= 0)
+    {
+        close(led_lp5562_fd);
+        led_lp5562_fd = -1;
+    }
+}
+
+/**
+ * @brief Write LED current to LP5562.
+ * Only the registers from the first to the last changed one are written, in a single I2C write
+ * using the register address auto increment of LP5562.
+ *
+ * @param [in]  hw         :  pointer of LED hardware image.
+ * @param [in]  lp5562_fd  :  fd of the I2C bus.
+ * @param [in]  led_config :  pointer of LED config.
+ * @param [out]            :  None.
+ *
+ * @return                 :  0 success, other value failed.
+ */
+static int led_lp5562_write_current(Led_Hw_Image *hw, int lp5562_fd, Led_Config *led_config)
+{
+    //registers B, G, R are at consecutive addresses, in the reverse order of the channels
+    uint8_t buf[4] = {0};
+    struct i2c_msg msg;
+    int first = -1;
+    int last = -1;
+    int channel = 0;
+    int i = 0;
+
+    for (i = 0; i < 3; i++)
+    {
+        channel = 2 - i;
+        if (!hw->lp5562_current_valid[channel] || (hw->lp5562_current[channel] != led_config->led_chip.channel[channel].current))
+        {
+            if (first < 0)
+            {
+                first = i;
+            }
+            last = i;
+        }
+    }
+    __atomic_add_fetch(&led_stats()->writes_avoided,(first < 0) ? 3 : (2 - last + first),__ATOMIC_RELAXED);
+    if (first < 0)
+    {
+        return 0;
+    }
+
+    buf[0] = LED_LP5562_B_CURRENT_REG + first;
+    for (i = first; i <= last; i++)
+    {
+        channel = 2 - i;
+        buf[1 + i - first] = led_config->led_chip.channel[channel].current;
+        hw->lp5562_current_valid[channel] = 0;
+    }
+    msg.addr = LED_LP5562_I2C_ADDR;
+    msg.flags = 0;
+    msg.len = 2 + last - first;
+    msg.buf = buf;
+    if (led_lp5562_i2c_transfer(lp5562_fd,&msg,1))
+    {
+        return -1;
+    }
+
+    for (i = first; i <= last; i++)
+    {
+        channel = 2 - i;
+        hw->lp5562_current[channel] = led_config->led_chip.channel[channel].current;
+        hw->lp5562_current_valid[channel] = 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Apply LED config to LP5562.
+ * Only the current registers and engine programs which differ from the hardware image are written.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  hw         :  pointer of LED hardware image.
+ * @param [in]  id         :  Identifier of a led.
+ * @param [in]  led_config :  pointer of LED config.
+ * @param [out]            :  None.
+ *
+ * @return                 :  0 success, other value failed.
+ */
+static int led_apply_lp5562_setting(Led_Hw_Image *hw, ledId_t id, Led_Config *led_config)
+{
+	Led_LP5562_Program lp5562_program;
+    int changed = 0;
+    int lp5562_fd = -1;
+    int ret = 0;
+    int i = 0;
+
+    (void)id;
+	//transfer command to LP5562's program
+	led_get_lp5562_program(led_config,&lp5562_program);
+
+    for (i = 0; i < 3; i++)
+    {
+        changed |= !hw->lp5562_current_valid[i] || (hw->lp5562_current[i] != led_config->led_chip.channel[i].current);
+    }
+    if (!changed &&
+        hw->lp5562_engines.valid && !memcmp(&hw->lp5562_engines.program,&lp5562_program,sizeof(Led_LP5562_Program)))
+    {
+        //LP5562 already shows this config
+        __atomic_add_fetch(&led_stats()->apply_noops,1,__ATOMIC_RELAXED);
+        __atomic_add_fetch(&led_stats()->writes_avoided,3,__ATOMIC_RELAXED);
+        __atomic_add_fetch(&led_stats()->engine_reload_skips,1,__ATOMIC_RELAXED);
+        return 0;
+    }
+
+    lp5562_fd = led_lp5562_open();
+    if (lp5562_fd < 0)
+    {
+        return -1;
+    }
+
+	//apply current to LP5562
+    if (led_lp5562_write_current(hw,lp5562_fd,led_config))
+    {
+        //the bus may be gone, open it again next time
+        led_lp5562_close();
+        return -1;
+    }
+
+    //apply commands to lp5562 chip
+    ret = led_lp5562_load_engines(&hw->lp5562_engines,lp5562_fd,&lp5562_program);
+
+    return ret;
+}
+
+/**
+ * @brief step of an AW210XX blink
+ * @member variable on       : 1 -- led on with the blink color, 0 -- led off
+ * @member variable duration : time of the step in ms
+*/
+typedef struct Led_AW210XX_Step{
+    int on;
+    uint32_t duration;
+}Led_AW210XX_Step;
+
+/**
+ * @brief AW210XX blink engine
+ * Blinks are run by a thread of the process which applied them, it steps through the blink on a timerfd.
+ * All members are guarded by the hardware image lock.
+ * @member variable timer_fd   : one-shot timer, expires at the end of the current step
+ * @member variable generation : Led_Hw_Image aw210xx_generation of the blink, the blink stops once another apply happened
+ * @member variable count      : number of steps, 0 -- no blink running
+ * @member variable index      : current step
+ * @member variable on_value   : rgbcolor value of on steps
+ * @member variable step       : steps of the blink, repeated forever
+*/
+typedef struct Led_AW210XX_Blink{
+    int timer_fd;
+    uint32_t generation;
+    int count;
+    int index;
+    char on_value[LED_AW210XX_VALUE_LEN];
+    Led_AW210XX_Step step[LED_AW210XX_MAX_STEPS];
+}Led_AW210XX_Blink;
+
+static Led_AW210XX_Blink led_aw210xx_blink = {-1, 0, 0, 0, "", {{0,0}}};
+static pthread_once_t led_aw210xx_blink_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Arm the AW210XX blink timer.
+ *
+ * @param [in]  duration :  time until expiry in ms, 0 disarms the timer.
+ * @param [out]          :  None.
+ *
+ * @return               :  0 success, other value failed.
+ */
+static int led_aw210xx_blink_arm(uint32_t duration)
+{
+    struct itimerspec timer;
+
+    memset(&timer,0,sizeof(timer));
+    timer.it_value.tv_sec = duration / 1000;
+    timer.it_value.tv_nsec = (duration % 1000) * 1000000;
+
+    return timerfd_settime(led_aw210xx_blink.timer_fd,0,&timer,NULL);
+}
+
+/**
+ * @brief Write the current step of the AW210XX blink to rgbcolor.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  hw :  pointer of LED hardware image.
+ * @param [out]    :  None.
+ *
+ * @return         :  0 success, other value failed.
+ */
+static int led_aw210xx_blink_write(Led_Hw_Image *hw)
+{
+    Led_AW210XX_Blink *blink = &led_aw210xx_blink;
+    const char *value = blink->step[blink->index].on ? blink->on_value : LED_AW210XX_OFF_VALUE;
+
+    if (led_sysfs_write(LED_SYSFS_AW210XX_RGBCOLOR,value))
+    {
+        hw->aw210xx_valid = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief AW210XX blink thread.
+ * Waits for the blink timer, moves to the next step and arms the timer for it.
+ *
+ * @param [in]  arg :  None.
+ * @param [out]     :  None.
+ *
+ * @return          :  None.
+ */
+static void* led_aw210xx_blink_thread(void *arg)
+{
+    Led_AW210XX_Blink *blink = &led_aw210xx_blink;
+    Led_Hw_Image *hw = NULL;
+    struct itimerspec timer;
+    uint64_t expirations = 0;
+
+    (void)arg;
+    while (1)
+    {
+        if (sizeof(expirations) != read(blink->timer_fd,&expirations,sizeof(expirations)))
+        {
+            if (EINTR != errno)
+            {
+                LEDMGR_LOG_ERROR("read AW210XX blink timer error: %s\n", strerror(errno));
+                usleep(LED_SYSFS_OPEN_RETRY_INTERVAL);
+            }
+            continue;
+        }
+
+        hw = led_hw_lock(LED_HW_AW210XX);
+        //an apply may have re-armed the timer while this thread waited for the lock
+        if ((0 == timerfd_gettime(blink->timer_fd,&timer)) && !timer.it_value.tv_sec && !timer.it_value.tv_nsec)
+        {
+            if (blink->count && (blink->generation == hw->aw210xx_generation))
+            {
+                blink->index = (blink->index + 1) % blink->count;
+                led_aw210xx_blink_write(hw);
+                led_aw210xx_blink_arm(blink->step[blink->index].duration);
+            }
+            else
+            {
+                //led has been set by another apply, possibly from another process
+                blink->count = 0;
+            }
+        }
+        led_hw_unlock(hw,LED_HW_AW210XX);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Start the AW210XX blink thread.
+ *
+ * @param [in]  :  None.
+ * @param [out] :  None.
+ *
+ * @return      :  None.
+ */
+static void led_aw210xx_blink_init(void)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    led_aw210xx_blink.timer_fd = timerfd_create(CLOCK_MONOTONIC,TFD_CLOEXEC);
+    if (led_aw210xx_blink.timer_fd < 0)
+    {
+        LEDMGR_LOG_ERROR("create AW210XX blink timer error: %s\n", strerror(errno));
+        return;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread,&attr,led_aw210xx_blink_thread,NULL))
+    {
+        LEDMGR_LOG_ERROR("create AW210XX blink thread error\n");
+        close(led_aw210xx_blink.timer_fd);
+        led_aw210xx_blink.timer_fd = -1;
+    }
+    pthread_attr_destroy(&attr);
+}
+
+/**
+ * @brief Append a step to the AW210XX blink, a step with the same state as the previous one extends it.
+ *
+ * @param [in]  on       :  1 -- led on, 0 -- led off.
+ * @param [in]  duration :  time of the step in ms.
+ * @param [out]          :  None.
+ *
+ * @return               :  None.
+ */
+static void led_aw210xx_blink_add_step(int on, uint32_t duration)
+{
+    Led_AW210XX_Blink *blink = &led_aw210xx_blink;
+
+    if (0 == duration)
+    {
+        return;
+    }
+    if (blink->count && (blink->step[blink->count-1].on == on))
+    {
+        blink->step[blink->count-1].duration += duration;
+    }
+    else if (blink->count < LED_AW210XX_MAX_STEPS)
+    {
+        blink->step[blink->count].on = on;
+        blink->step[blink->count].duration = duration;
+        blink->count++;
+    }
+}
+
+/**
+ * @brief Start a blink on AW210XX.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  hw         :  pointer of LED hardware image.
+ * @param [in]  led_config :  pointer of LED config, Led_BLINK or Led_SEQ_BLINK.
+ * @param [out]            :  None.
+ *
+ * @return                 :  0 success, other value failed.
+ */
+static int led_aw210xx_blink_start(Led_Hw_Image *hw, Led_Config *led_config)
+{
+    Led_AW210XX_Blink *blink = &led_aw210xx_blink;
+    uint32_t count = 0;
+    uint32_t i = 0;
+
+    pthread_once(&led_aw210xx_blink_once,led_aw210xx_blink_init);
+    if (blink->timer_fd < 0)
+    {
+        return -1;
+    }
+
+    blink->count = 0;
+    blink->index = 0;
+    if (Led_BLINK == led_config->action.act_type)
+    {
+        led_aw210xx_blink_add_step(1,led_config->action.on_time);
+        led_aw210xx_blink_add_step(0,led_config->action.off_time);
+    }
+    else
+    {
+        //repeat on/off1 count times, then stay off for off2
+        count = (led_config->action.count > 1) ? led_config->action.count : 1;
+        for (i = 0; i < count; i++)
+        {
+            led_aw210xx_blink_add_step(1,led_config->action.on_time);
+            led_aw210xx_blink_add_step(0,led_config->action.off1_time);
+        }
+        led_aw210xx_blink_add_step(0,led_config->action.off2_time);
+    }
+    blink->generation = hw->aw210xx_generation;
+
+    if (0 == blink->count)
+    {
+        //no time in any step, nothing to blink
+        led_aw210xx_blink_arm(0);
+        return led_sysfs_write(LED_SYSFS_AW210XX_RGBCOLOR,LED_AW210XX_OFF_VALUE);
+    }
+    if (1 == blink->count)
+    {
+        //only on or only off time, hold it
+        led_aw210xx_blink_arm(0);
+        blink->count = 0;
+        return led_sysfs_write(LED_SYSFS_AW210XX_RGBCOLOR,blink->step[0].on ? blink->on_value : LED_AW210XX_OFF_VALUE);
+    }
+
+    if (led_aw210xx_blink_write(hw))
+    {
+        blink->count = 0;
+        led_aw210xx_blink_arm(0);
+        return -1;
+    }
+
+    return led_aw210xx_blink_arm(blink->step[0].duration);
+}
+
+/**
+ * @brief Stop a blink on AW210XX run by this process.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  :  None.
+ * @param [out] :  None.
+ *
+ * @return      :  None.
+ */
+static void led_aw210xx_blink_stop(void)
+{
+    if (led_aw210xx_blink.count)
+    {
+        led_aw210xx_blink.count = 0;
+        led_aw210xx_blink_arm(0);
+    }
+}
+
+/**
+ * @brief Check AW210XX blinks are run by the chip's pattern controller.
+ * Enabled with LED_OPT_AW210XX_PATTERN, or for all processes with LED_AW210XX_PATTERN_FILE.
+ *
+ * @param [in]  :  None.
+ * @param [out] :  None.
+ *
+ * @return      :  1 use the pattern controller, 0 use the blink thread.
+ */
+static int led_aw210xx_pattern_enabled(void)
+{
+    char path[LED_PATH_MAX_LENGTH] = {0};
+
+    return led_aw210xx_pattern || (0 == access(led_path(LED_AW210XX_PATTERN_FILE,path), F_OK));
+}
+
+/**
+ * @brief Get the pattern controller timing code of a time.
+ * The pattern controller only supports a fixed set of times, a time is used if it is within
+ * LED_AW210XX_PATTERN_TOLERANCE percent of one of them.
+ *
+ * @param [in]  time :  time in ms.
+ * @param [out] code :  timing code, 0~15.
+ *
+ * @return           :  0 success, other value the time can not be represented.
+ */
+static int led_aw210xx_pattern_time(uint32_t time, uint8_t *code)
+{
+    static const uint32_t pattern_time[16] = {0, 130, 260, 380, 510, 770, 1040, 1600, 2100, 2600, 3100, 4200, 5200, 6200, 7300, 8300};
+    uint32_t diff = 0;
+    int i = 0;
+
+    for (i = 0; i < 16; i++)
+    {
+        diff = (time > pattern_time[i]) ? (time - pattern_time[i]) : (pattern_time[i] - time);
+        if ((diff * 100) <= (pattern_time[i] * LED_AW210XX_PATTERN_TOLERANCE))
+        {
+            *code = i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Write a register of AW210XX through the driver's reg interface.
+ *
+ * @param [in]  reg   :  register address.
+ * @param [in]  value :  register value.
+ * @param [out]       :  None.
+ *
+ * @return            :  0 success, other value failed.
+ */
+static int led_aw210xx_write_reg(uint8_t reg, uint8_t value)
+{
+    char buf[16] = {0};
+
+    snprintf(buf,sizeof(buf),"0x%02x 0x%02x",reg,value);
+
+    return led_sysfs_write(LED_SYSFS_AW210XX_REG,buf);
+}
+
+/**
+ * @brief Stop the AW210XX pattern controller.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  hw :  pointer of LED hardware image.
+ * @param [out]    :  None.
+ *
+ * @return         :  0 success, other value failed.
+ */
+static int led_aw210xx_pattern_stop(Led_Hw_Image *hw)
+{
+    if (!hw->aw210xx_pattern)
+    {
+        return 0;
+    }
+
+    if (led_aw210xx_write_reg(LED_AW210XX_PATGO_REG,0) || led_aw210xx_write_reg(LED_AW210XX_PATCFG_REG,0))
+    {
+        return -1;
+    }
+    hw->aw210xx_pattern = 0;
+
+    return 0;
+}
+
+/**
+ * @brief Run a blink on the AW210XX pattern controller.
+ * The led is set to the blink color, then the pattern controller switches it between the color (on time) and off (off time)
+ * with no rise and fall time, forever. A sequence blink can only be run if it blinks once per sequence.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  hw         :  pointer of LED hardware image.
+ * @param [in]  led_config :  pointer of LED config, Led_BLINK or Led_SEQ_BLINK.
+ * @param [in]  on_value   :  rgbcolor value of the blink color.
+ * @param [out]            :  None.
+ *
+ * @return                 :  0 success, 1 the blink can not be run by the pattern controller, other value failed.
+ */
+static int led_aw210xx_pattern_start(Led_Hw_Image *hw, Led_Config *led_config, const char *on_value)
+{
+    uint32_t off_time = led_config->action.off_time;
+    uint8_t on_code = 0;
+    uint8_t off_code = 0;
+
+    if (Led_SEQ_BLINK == led_config->action.act_type)
+    {
+        if (led_config->action.count > 1)
+        {
+            return 1;
+        }
+        off_time = led_config->action.off1_time + led_config->action.off2_time;
+    }
+    if (led_aw210xx_pattern_time(led_config->action.on_time,&on_code) || led_aw210xx_pattern_time(off_time,&off_code) || !on_code || !off_code)
+    {
+        return 1;
+    }
+
+    hw->aw210xx_pattern = 1;
+    if (led_sysfs_write(LED_SYSFS_AW210XX_RGBCOLOR,on_value) ||
+        led_aw210xx_write_reg(LED_AW210XX_FADEH_REG,0xFF) ||
+        led_aw210xx_write_reg(LED_AW210XX_FADEL_REG,0) ||
+        led_aw210xx_write_reg(LED_AW210XX_PATT0_REG,on_code) ||           //T1 rise 0, T2 on
+        led_aw210xx_write_reg(LED_AW210XX_PATT1_REG,off_code) ||          //T3 fall 0, T4 off
+        led_aw210xx_write_reg(LED_AW210XX_PATT2_REG,0) ||                 //T0 start delay 0
+        led_aw210xx_write_reg(LED_AW210XX_PATT3_REG,0) ||                 //repeat forever
+        led_aw210xx_write_reg(LED_AW210XX_GCFG0_REG,LED_AW210XX_GCFG0_LED0) ||
+        led_aw210xx_write_reg(LED_AW210XX_PATCFG_REG,LED_AW210XX_PATCFG_AUTO) ||
+        led_aw210xx_write_reg(LED_AW210XX_PATGO_REG,LED_AW210XX_PATGO_RUN))
+    {
+        led_aw210xx_pattern_stop(hw);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Map a fade or breathe action to the nearest action of a device without pwm ramps.
+ * Fade in becomes on, fade out becomes off and breathe becomes a blink with the rise and fall times.
+ *
+ * @param [in]  action :  action to map.
+ * @param [out] action :  action the device supports.
+ *
+ * @return             :  None.
+ */
+static void led_action_without_ramp(Led_Action *action)
+{
+    if (Led_FADE_IN == action->act_type)
+    {
+        action->act_type = Led_ON;
+    }
+    else if (Led_FADE_OUT == action->act_type)
+    {
+        action->act_type = Led_OFF;
+    }
+    else if (Led_BREATHE == action->act_type)
+    {
+        action->act_type = Led_BLINK;
+    }
+}
+
+/**
+ * @brief Apply LED config to AW210XX.
+ * Colors are written to rgbcolor. Blinks are run by the chip's pattern controller if enabled and the blink timing
+ * can be represented, otherwise by the blink thread of this process.
+ * Nothing is done if AW210XX already shows the same color or runs the same blink.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  hw         :  pointer of LED hardware image.
+ * @param [in]  id         :  Identifier of a led.
+ * @param [in]  led_config :  pointer of LED config.
+ * @param [out]            :  None.
+ *
+ * @return                 :  0 success, other value failed.
+ */
+static int led_apply_aw21009_setting(Led_Hw_Image *hw, ledId_t id, Led_Config *led_config)
+{
+    char state[LED_AW210XX_STATE_LEN] = {0};
+    char on_value[LED_AW210XX_VALUE_LEN] = {0};
+    Led_Config config = *led_config;
+    int blink = 0;
+    int ret = -1;
+
+    (void)id;
+    //AW210XX has no pwm ramps, fades are shown as on/off/blink
+    led_action_without_ramp(&config.action);
+    led_config = &config;
+
+    snprintf(on_value,sizeof(on_value),"0x00 0x%02x%02x%02x 0x%02x%02x%02x",
+             led_config->led_chip.channel[0].current, led_config->led_chip.channel[1].current, led_config->led_chip.channel[2].current,
+             led_config->led_chip.channel[0].pwm, led_config->led_chip.channel[1].pwm, led_config->led_chip.channel[2].pwm);
+
+    if (Led_OFF == led_config->action.act_type)
+    {
+        snprintf(state,sizeof(state),"%s",LED_AW210XX_OFF_VALUE);
+    }
+    else if (Led_BLINK == led_config->action.act_type)
+    {
+        blink = 1;
+        snprintf(state,sizeof(state),"blink %s %u %u", on_value, led_config->action.on_time, led_config->action.off_time);
+    }
+    else if (Led_SEQ_BLINK == led_config->action.act_type)
+    {
+        blink = 1;
+        snprintf(state,sizeof(state),"sequence_blink %s %u %u %u %u", on_value, led_config->action.on_time, led_config->action.off1_time, led_config->action.count, led_config->action.off2_time);
+    }
+    else
+    {
+        snprintf(state,sizeof(state),"%s",on_value);
+    }
+
+    //same color, or the same blink is still run by its process
+    if (hw->aw210xx_valid && !strcmp(hw->aw210xx_state,state) &&
+        (!blink || hw->aw210xx_pattern || ((getpid() == hw->aw210xx_pid) ? (led_aw210xx_blink.count > 0) : (0 == kill(hw->aw210xx_pid,0)))))
+    {
+        __atomic_add_fetch(&led_stats()->apply_noops,1,__ATOMIC_RELAXED);
+        __atomic_add_fetch(&led_stats()->writes_avoided,1,__ATOMIC_RELAXED);
+        return 0;
+    }
+
+    hw->aw210xx_valid = 0;
+    //stops any blink, in this or another process
+    hw->aw210xx_generation++;
+    led_aw210xx_blink_stop();
+    if (led_aw210xx_pattern_stop(hw))
+    {
+        return -1;
+    }
+
+    if (blink && led_aw210xx_pattern_enabled() && (0 == (ret = led_aw210xx_pattern_start(hw,led_config,on_value))))
+    {
+        //blink runs in the chip, no process keeps it alive
+        blink = 0;
+    }
+    else if (blink)
+    {
+        memcpy(led_aw210xx_blink.on_value,on_value,sizeof(on_value));
+        ret = led_aw210xx_blink_start(hw,led_config);
+    }
+    else
+    {
+        ret = led_sysfs_write(LED_SYSFS_AW210XX_RGBCOLOR,state);
+    }
+
+    if (!ret)
+    {
+        memcpy(hw->aw210xx_state,state,sizeof(hw->aw210xx_state));
+        hw->aw210xx_pid = getpid();
+        hw->aw210xx_valid = 1;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Apply LED config to the remote XW front panel LED.
+ * The config is forwarded to the LED HAL of XW as a whole, replacing what XW had.
+ *
+ * @param [in]  hw         :  pointer of LED hardware image.
+ * @param [in]  id         :  Identifier of a led.
+ * @param [in]  led_config :  pointer of LED config.
+ * @param [out]            :  None.
+ *
+ * @return                 :  0 success, other value failed.
+ */
+static int led_apply_xw_setting(Led_Hw_Image *hw, ledId_t id, Led_Config *led_config)
+{
+    Led_Action action = led_config->action;
+    int ret = 0;
+
+    (void)hw;
+    //fades are not forwarded, XW is shown the nearest on/off/blink
+    led_action_without_ramp(&action);
+
+    ret |= xw_led_reset(id);
+    ret |= xw_led_setEnable(id,led_config->state);
+    if (led_config->state)
+    {
+        ret |= xw_led_setBrightness(id,led_config->led_chip.channel[0].pwm,led_config->led_chip.channel[1].pwm,led_config->led_chip.channel[2].pwm);
+        ret |= xw_led_setColor(id,led_config->led_chip.channel[0].current,led_config->led_chip.channel[1].current,led_config->led_chip.channel[2].current);
+        switch (action.act_type)
+        {
+            case Led_BLINK:
+                ret |= xw_led_setBlink(id,action.on_time,action.off_time);
+                break;
+            case Led_SEQ_BLINK:
+                ret |= xw_led_setBlinkSequence(id,action.on_time,action.off1_time,action.count,action.off2_time);
+                break;
+            case Led_OFF:
+                ret |= xw_led_setOnOff(id,"off");
+                break;
+            case Led_ON:
+            default:
+                ret |= xw_led_setOnOff(id,"on");
+                break;
+        }
+    }
+    ret |= xw_led_applySettings(id);
+
+    return ret;
+}
+
+//fd of LED_SIM_LOG_FILE, opened once, protected by the hardware image lock
+static int led_sim_log_fd = -1;
+
+/**
+ * @brief Write a value to the simulated device.
+ * The value is written to a file of LED_SIM_PATH and recorded in LED_SIM_LOG_FILE as
+ * "<CLOCK_MONOTONIC seconds>.<nanoseconds> <file> <value>", so writes can be counted and timed.
+ * Must be called with the hardware image locked.
+ *
+ * @param [in]  name  :  file name in LED_SIM_PATH.
+ * @param [in]  value :  value to write.
+ * @param [out]       :  None.
+ *
+ * @return            :  0 success, other value failed.
+ */
+static int led_sim_write(const char *name, const char *value)
+{
+    char path[LED_PATH_MAX_LENGTH] = {0};
+    char file[LED_PATH_MAX_LENGTH] = {0};
+    char buf[LED_SIM_STATE_LEN + LED_PATH_MAX_LENGTH] = {0};
+    struct timespec now;
+    int fd = -1;
+    int len = 0;
+    int ret = -1;
+
+    mkdir(led_path(LED_SIM_PATH,path),S_IRWXU|S_IRWXG|S_IRWXO);
+    if (led_sim_log_fd < 0)
+    {
+        led_sim_log_fd = open(led_path(LED_SIM_LOG_FILE,path),O_WRONLY|O_CREAT|O_APPEND|O_CLOEXEC,S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH);
+    }
+
+    snprintf(file,sizeof(file),"%s/%s",led_path(LED_SIM_PATH,path),name);
+    fd = open(file,O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH);
+    if (fd < 0)
+    {
+        LEDMGR_LOG_ERROR("open %s error: %s\n", file, strerror(errno));
+        return -1;
+    }
+    len = snprintf(buf,sizeof(buf),"%s\n",value);
+    ret = (len == write(fd,buf,len)) ? 0 : -1;
+    close(fd);
+
+    if (!ret && (led_sim_log_fd >= 0))
+    {
+        clock_gettime(CLOCK_MONOTONIC,&now);
+        len = snprintf(buf,sizeof(buf),"%ld.%09ld %s %s\n",(long)now.tv_sec,now.tv_nsec,name,value);
+        if (len != write(led_sim_log_fd,buf,len))
+        {
+            LEDMGR_LOG_WARN("write %s error: %s\n", LED_SIM_LOG_FILE, strerror(errno));
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Apply LED config to the simulated device.
+ * The led state is written to the file led_<id> of LED_SIM_PATH, only if it differs from what was last written.
+ *
+ * @param [in]  hw         :  pointer of LED hardware image.
+ * @param [in]  id         :  Identifier of a led.
+ * @param [in]  led_config :  pointer of LED config.
+ * @param [out]            :  None.
+ *
+ * @return                 :  0 success, other value failed.
+ */
+static int led_apply_sim_setting(Led_Hw_Image *hw, ledId_t id, Led_Config *led_config)
+{
+    char state[LED_SIM_STATE_LEN] = {0};
+    char name[16] = {0};
+    const uint8_t *byte = (const uint8_t *)&led_config->action.pattern;
+    uint32_t pattern = 2166136261u;
+    size_t index = 0;
+
+    //FNV-1a of the pattern, which does not fit in the state
+    for (index = 0; index < sizeof(led_config->action.pattern); index++)
+    {
+        pattern = (pattern ^ byte[index]) * 16777619u;
+    }
+    snprintf(state,sizeof(state),"state=%d action=%d on=%u off=%u off1=%u count=%u off2=%u color=%d,%d,%d brightness=%d,%d,%d ir=%d ramp=%u pattern=%08x",
+        led_config->state,led_config->action.act_type,led_config->action.on_time,led_config->action.off_time,
+        led_config->action.off1_time,led_config->action.count,led_config->action.off2_time,
+        led_config->led_chip.channel[0].current,led_config->led_chip.channel[1].current,led_config->led_chip.channel[2].current,
+        led_config->led_chip.channel[0].pwm,led_config->led_chip.channel[1].pwm,led_config->led_chip.channel[2].pwm,
+        led_config->led_irled.brightness,led_config->led_irled.ramp_time,pattern);
+
+    if (hw->sim_valid[id] && !strcmp(hw->sim_state[id],state))
+    {
+        __atomic_add_fetch(&led_stats()->apply_noops,1,__ATOMIC_RELAXED);
+        __atomic_add_fetch(&led_stats()->writes_avoided,1,__ATOMIC_RELAXED);
+        return 0;
+    }
+    hw->sim_valid[id] = 0;
+
+    snprintf(name,sizeof(name),"led_%d",id);
+    if (led_sim_write(name,state))
+    {
+        return -1;
+    }
+    memcpy(hw->sim_state[id],state,sizeof(hw->sim_state[id]));
+    hw->sim_valid[id] = 1;
+
+    return 0;
+}
+
+/**
+ * @brief Check LP5562 drives a LED.
+ * LP5562 is the camera front panel chip, it is present once its I2C device has been probed.
+ *
+ * @param [in]  id :  Identifier of a led.
+ *
+ * @return         :  1 yes, 0 no.
+ */
+static int led_detect_lp5562(ledId_t id)
+{
+    char path[LED_PATH_MAX_LENGTH] = {0};
+
+    return (LED_ID_CAMERA_FRONT_PANEL == id) && (0 == access(led_path(LED_LP5562_DEVICE_PATH,path), F_OK));
+}
+
+/**
+ * @brief Open the I2C bus of LP5562, so applies do not pay for it.
+ *
+ * @param [in]  id :  Identifier of a led.
+ *
+ * @return         :  0 success, other value failed.
+ */
+static int led_init_lp5562(ledId_t id)
+{
+    Led_Hw_Image *hw = led_hw_lock(LED_HW_LP5562);
+    int lp5562_fd = led_lp5562_open();
+
+    (void)id;
+    led_hw_unlock(hw,LED_HW_LP5562);
+
+    return (lp5562_fd < 0) ? -1 : 0;
+}
+
+/**
+ * @brief Check AW210XX drives a LED.
+ * AW210XX is the camera front panel chip on the boards flagged by LEDS_CHIP_AW210XX_FILE.
+ *
+ * @param [in]  id :  Identifier of a led.
+ *
+ * @return         :  1 yes, 0 no.
+ */
+static int led_detect_aw210xx(ledId_t id)
+{
+    char path[LED_PATH_MAX_LENGTH] = {0};
+
+    return (LED_ID_CAMERA_FRONT_PANEL == id) && (0 == access(led_path(LEDS_CHIP_AW210XX_FILE,path), F_OK));
+}
+
+/**
+ * @brief Check the IR PWM backlight drives a LED.
+ *
+ * @param [in]  id :  Identifier of a led.
+ *
+ * @return         :  1 yes, 0 no.
+ */
+static int led_detect_irled(ledId_t id)
+{
+    return (LED_ID_CAMERA_IR == id);
+}
+
+/**
+ * @brief Check the remote XW drives a LED.
+ *
+ * @param [in]  id :  Identifier of a led.
+ *
+ * @return         :  1 yes, 0 no.
+ */
+static int led_detect_xw(ledId_t id)
+{
+    return (LED_ID_XW_FRONT_PANEL == id);
+}
+
+/**
+ * @brief Connect the remote XW front panel LED.
+ *
+ * @param [in]  id :  Identifier of a led.
+ *
+ * @return         :  0 success, other value failed.
+ */
+static int led_init_xw(ledId_t id)
+{
+    return xw_led_init(id);
+}
+
+//LED backends, detected in this order
+static const Led_Backend led_backends[] = {
+    {"aw210xx", LED_BACKEND_CAP_COLOR | LED_BACKEND_CAP_BLINK, led_detect_aw210xx, NULL, led_apply_aw21009_setting, LED_LATENCY_BACKEND_AW210XX, LED_HW_AW210XX},
+    {"lp5562", LED_BACKEND_CAP_COLOR | LED_BACKEND_CAP_BLINK | LED_BACKEND_CAP_PATTERN, led_detect_lp5562, led_init_lp5562, led_apply_lp5562_setting, LED_LATENCY_BACKEND_LP5562, LED_HW_LP5562},
+    {"irled", LED_BACKEND_CAP_RAMP, led_detect_irled, NULL, led_apply_irled_setting, LED_LATENCY_BACKEND_IRLED, LED_HW_IRLED},
+    {"xw", LED_BACKEND_CAP_COLOR | LED_BACKEND_CAP_BLINK, led_detect_xw, led_init_xw, led_apply_xw_setting, LED_LATENCY_BACKEND_XW, LED_HW_XW},
+    {"sim", LED_BACKEND_CAP_COLOR | LED_BACKEND_CAP_BLINK | LED_BACKEND_CAP_RAMP | LED_BACKEND_CAP_PATTERN, NULL, NULL, led_apply_sim_setting, LED_LATENCY_BACKEND_SIM, LED_HW_SIM},
+};
+
+//backend of every led, bound on first use and kept for the life of the process
+static const Led_Backend *led_backend[LED_ID_MAX];
+static pthread_mutex_t led_backend_mutex = PTHREAD_MUTEX_INITIALIZER;
+//a failed bind was logged, guarded by led_backend_mutex
+static int led_backend_warned[LED_ID_MAX];
+
+/**
+ * @brief Find the backend of a led.
+ * The camera front panel LED uses the backend named by LED_BACKEND_ENV if set, otherwise the first backend detected.
+ * The XW and IR LEDs always use the backend detected. sim is only used when named, a LED no backend detects stays unbound.
+ * Must be called with led_backend_mutex locked.
+ *
+ * @param [in]  id :  Identifier of a led.
+ * @param [out]    :  None.
+ *
+ * @return         :  pointer of the backend, NULL if none drives the led yet.
+ */
+static const Led_Backend* led_backend_bind(ledId_t id)
+{
+    const char *name = getenv(LED_BACKEND_ENV);
+    const Led_Backend *backend = NULL;
+    int backend_num = sizeof(led_backends)/sizeof(led_backends[0]);
+    int i = 0;
+
+    if ((LED_ID_CAMERA_FRONT_PANEL == id) && name && name[0])
     {
-        flock(config_fd, LOCK_UN);
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, read config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        for (i = 0; i < backend_num; i++)
+        {
+            if (!strcmp(name,led_backends[i].name))
+            {
+                backend = &led_backends[i];
+            }
+        }
+        if (!backend && !led_backend_warned[id])
+        {
+            LEDMGR_LOG_WARN(" %s unknown backend %s, detect it\n",__FUNCTION__,name);
+        }
     }
-    //check LED state
-    if (!led_config.state)
+    for (i = 0; !backend && (i < backend_num); i++)
     {
-        flock(config_fd, LOCK_UN);
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_OPERATION_NOT_SUPPORTED],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] led is disabled, does not support configure\n",__FUNCTION__,__LINE__);
-
-        return LED_ERR_OPERATION_NOT_SUPPORTED;
+        if (led_backends[i].detect && led_backends[i].detect(id))
+        {
+            backend = &led_backends[i];
+        }
     }
 
-	led_config.action.act_type = Led_SEQ_BLINK;
-	led_config.action.on_time = ontime;
-	led_config.action.off1_time = offtime1;
-	led_config.action.count = count;
-	led_config.action.off2_time = offtime2;
-    
-	ret = write_led_config(config_fd, &led_config);
-    flock(config_fd,LOCK_UN);
-    close(config_fd);
-    if (0 == ret)
+    if (backend)
     {
-        return LED_ERR_NONE;
+        LEDMGR_LOG_INFO(" %s id %d uses backend %s\n",__FUNCTION__,id,backend->name);
     }
-    else
+    else if (!led_backend_warned[id])
     {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, write config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        //the device may not be probed yet, detect again on the next use
+        LEDMGR_LOG_WARN(" %s id %d no backend detected, its applies fail until one is\n",__FUNCTION__,id);
     }
+    led_backend_warned[id] = !backend;
+
+    return backend;
 }
 
-ledError_t led_setOnOff(ledId_t id, const char* onoff)
+/**
+ * @brief Get the backend of a led, binding it on first use.
+ *
+ * @param [in]  id :  Identifier of a led.
+ * @param [out]    :  None.
+ *
+ * @return         :  pointer of the backend, NULL if no backend drives the led.
+ */
+static const Led_Backend* led_get_backend(ledId_t id)
 {
-    char led_config_file[LED_CONFIG_FILE_NAME_LENGTH] = {0};
-    int config_fd = -1;
-    Led_Config led_config;
-    int ret = -1;
+    const Led_Backend *backend = __atomic_load_n(&led_backend[id],__ATOMIC_ACQUIRE);
 
-    LEDMGR_LOG_DEBUG(" %s id: %d onoff: %s \n",__FUNCTION__, id, onoff);
-    //check parameter
-    if ((LED_ID_CAMERA_FRONT_PANEL != id) &&(LED_ID_XW_FRONT_PANEL != id) && (LED_ID_CAMERA_IR != id))
+    if (backend)
     {
-        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
-        return LED_ERR_INVALID_PARAM;
+        return backend;
     }
 
-    if ((strcmp(onoff,"on")) && (strcmp(onoff,"off")))
+    pthread_mutex_lock(&led_backend_mutex);
+    backend = led_backend[id];
+    if (!backend)
     {
-        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] onoff value %s is illegal\n",__FUNCTION__,__LINE__,onoff);
-        return LED_ERR_INVALID_PARAM;
+        backend = led_backend_bind(id);
+        __atomic_store_n(&led_backend[id],backend,__ATOMIC_RELEASE);
     }
+    pthread_mutex_unlock(&led_backend_mutex);
 
-    //open LED config file
-    snprintf(led_config_file,sizeof(led_config_file),"%s%s%d",LED_CONFIG_FILE_PATH,LED_CONFIG_FILE_PREFIX,id);
-    config_fd = open(led_config_file,O_RDWR);
-    if (config_fd < 0)
-    {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, open config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
-    }
+    return backend;
+}
 
-    //lock LED config file
-    if (lock_led_config(config_fd))
-    {
-        //lock failed
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, lock config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
-    }
+/**
+ * @brief Apply LED config to the device, through the backend of the led.
+ *
+ * @param [in]  id         :  Identifier of a led.
+ * @param [in]  led_config :  pointer of LED config.
+ * @param [out]            :  None.
+ *
+ * @return                 :  0 success, other value failed.
+ */
+static int led_apply_config(ledId_t id, Led_Config *led_config)
+{
+    const Led_Backend *backend = led_get_backend(id);
+    uint64_t start = led_latency_now();
+    Led_Hw_Image *hw = NULL;
+    int ret = 0;
 
-    //read LED config
-    if (read_led_config(config_fd,&led_config))
+    if (!backend)
     {
-        //read LED config failed
-        flock(config_fd,LOCK_UN);
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, read config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        return -1;
     }
+    hw = led_hw_lock(backend->device);
+    ret = backend->apply(hw,id,led_config);
+    led_hw_unlock(hw,backend->device);
+    led_latency_record(backend->latency,start);
 
-    //check LED state
-    if (!led_config.state)
-    {
-        //disable state, do not support change config
-        flock(config_fd,LOCK_UN);
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_OPERATION_NOT_SUPPORTED],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] led is disabled, does not support configure\n",__FUNCTION__,__LINE__);
+    return ret;
+}
 
-        return LED_ERR_OPERATION_NOT_SUPPORTED;;
-    }
-    
-    //update config
-    if (!strcmp(onoff,"on"))
-    {
-        //on
-		led_config.action.act_type = Led_ON;
-    }
-    else
+ledError_t led_applySettings(ledId_t id)
+{
+    uint64_t start = led_latency_now();
+    Led_Config led_config;
+
+    LEDMGR_LOG_DEBUG(" %s id: %d \n",__FUNCTION__, id);
+
+    //check parameter 
+    if ((LED_ID_CAMERA_FRONT_PANEL != id) &&(LED_ID_XW_FRONT_PANEL != id) && (LED_ID_CAMERA_IR != id))
     {
-        //off
-		led_config.action.act_type = Led_OFF;
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
+        return led_latency_return(LED_LATENCY_APPLY_SETTINGS,start,LED_ERR_INVALID_PARAM);
     }
-    //write LED config file
-    ret = write_led_config(config_fd,&led_config);
-    flock(config_fd,LOCK_UN);
-    close(config_fd);
-    if (0 == ret)
+
+    //take a snapshot of the committed LED config, the device is updated without holding the lock.
+    //the owner of an update in progress sees the config as of led_beginUpdate
+    led_read_config(id,&led_config);
+
+    if (led_apply_config(id,&led_config))
     {
-        return LED_ERR_NONE;
+        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, apply setting to device error\n",__FUNCTION__,__LINE__);
+        return led_latency_return(LED_LATENCY_APPLY_SETTINGS,start,LED_ERR_UNKNOWN);
     }
     else
     {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, write config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        return led_latency_return(LED_LATENCY_APPLY_SETTINGS,start,LED_ERR_NONE);
     }
 }
 
-static int led_apply_irled_setting(Led_Config *led_config)
+ledError_t led_applyAllSettings()
+{
+    LEDMGR_LOG_DEBUG(" %s \n",__FUNCTION__);
+
+    return led_for_all(led_applySettings,led_parallel_apply,NULL);
+}
+
+ledError_t led_applyAllSettingsEx(ledError_t status[LED_ID_MAX])
 {
-    char bightness_buf[8] = {0};
-    int brightness_fd = -1;
-    int try_times = 3;
-    int ret = -1;
+    LEDMGR_LOG_DEBUG(" %s \n",__FUNCTION__);
 
-    //open brightness file
-    do
+    return led_for_all(led_applySettings,led_parallel_apply,status);
+}
+
+//callers waiting on the queued apply of a led
+#define LED_ASYNC_MAX_WAITERS 16
+
+/**
+ * @brief Caller waiting on an asynchronous apply
+ * @member variable cb  : called with the result of the apply, may be NULL
+ * @member variable ctx : passed to cb
+*/
+typedef struct Led_Async_Waiter{
+    ledApplyCallback_t cb;
+    void *ctx;
+}Led_Async_Waiter;
+
+/**
+ * @brief Queued asynchronous apply of a led
+ * Applies queued before the worker takes the led are served by one apply of the newest config.
+ * @member variable pending : 1 -- the led must be applied
+ * @member variable count   : number of waiters
+ * @member variable waiter  : callers waiting on the apply
+*/
+typedef struct Led_Async_Slot{
+    int pending;
+    uint32_t count;
+    Led_Async_Waiter waiter[LED_ASYNC_MAX_WAITERS];
+}Led_Async_Slot;
+
+/**
+ * @brief Worker applying the queued leds of a device
+ * @member variable started : 1 -- thread is running
+ * @member variable cond    : signalled when a led of the device is queued
+*/
+typedef struct Led_Async_Worker{
+    int started;
+    pthread_cond_t cond;
+}Led_Async_Worker;
+
+static pthread_mutex_t led_async_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Led_Async_Slot led_async_slot[LED_ID_MAX];
+static Led_Async_Worker led_async_worker[LED_HW_DEVICE_MAX] = {
+    {0, PTHREAD_COND_INITIALIZER},
+    {0, PTHREAD_COND_INITIALIZER},
+    {0, PTHREAD_COND_INITIALIZER},
+    {0, PTHREAD_COND_INITIALIZER},
+    {0, PTHREAD_COND_INITIALIZER},
+};
+
+/**
+ * @brief Apply the queued leds of a device, one at a time.
+ * The callbacks are called on this thread, after the apply and without any lock held.
+ *
+ * @param [in]  arg :  device, as Led_Hw_Device.
+ * @param [out]     :  None.
+ *
+ * @return          :  NULL.
+ */
+static void* led_async_thread(void *arg)
+{
+    Led_Hw_Device device = (Led_Hw_Device)(intptr_t)arg;
+    Led_Async_Waiter waiter[LED_ASYNC_MAX_WAITERS];
+    uint32_t count = 0;
+    uint32_t index = 0;
+    ledError_t ret = LED_ERR_NONE;
+    int id = LED_ID_MAX;
+
+    while (1)
     {
-        brightness_fd = open(LED_IRLED_BRIGHTNESS_FILE,O_WRONLY);
-        if (brightness_fd < 0)
+        pthread_mutex_lock(&led_async_mutex);
+        while (1)
         {
-            usleep(5000);
+            for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++)
+            {
+                //a pending led has been bound when it was queued
+                if (led_async_slot[id].pending && (device == led_get_backend((ledId_t)id)->device))
+                {
+                    break;
+                }
+            }
+            if (id < LED_ID_MAX)
+            {
+                break;
+            }
+            pthread_cond_wait(&led_async_worker[device].cond,&led_async_mutex);
         }
-        try_times--;
-    }while((brightness_fd < 0) && (try_times > 0));
+        //take the waiters, applies queued from now on need another apply
+        count = led_async_slot[id].count;
+        memcpy(waiter,led_async_slot[id].waiter,count * sizeof(Led_Async_Waiter));
+        led_async_slot[id].pending = 0;
+        led_async_slot[id].count = 0;
+        pthread_mutex_unlock(&led_async_mutex);
 
-    if (brightness_fd < 0)
-    {
-        //open brightness file failed
-        return -1;
+        ret = led_applySettings((ledId_t)id);
+        for (index = 0; index < count; index++)
+        {
+            if (waiter[index].cb)
+            {
+                waiter[index].cb((ledId_t)id,ret,waiter[index].ctx);
+            }
+        }
     }
 
-    if (Led_ON == led_config->action.act_type)
-    {
-        snprintf(bightness_buf,sizeof(bightness_buf),"%d",led_config->led_irled.brightness);
-    }
-    else
-    {
-        snprintf(bightness_buf,sizeof(bightness_buf),"0");
-    }
+    return NULL;
+}
 
-    //write brightness file
-    ret = write(brightness_fd,bightness_buf,strlen(bightness_buf));
-    close(brightness_fd);
+ledError_t led_applySettingsAsync(ledId_t id, ledApplyCallback_t cb, void *ctx)
+{
+    const Led_Backend *backend = NULL;
+    Led_Async_Slot *slot = NULL;
+    Led_Async_Worker *worker = NULL;
+    pthread_attr_t attr;
+    pthread_t thread;
+    ledError_t ret = LED_ERR_NONE;
 
-    if (strlen(bightness_buf) != ret)
-    {
-        return -1;
-    }
-    else
+    LEDMGR_LOG_DEBUG(" %s id: %d \n",__FUNCTION__, id);
+
+    //check parameter
+    if ((LED_ID_CAMERA_FRONT_PANEL != id) &&(LED_ID_XW_FRONT_PANEL != id) && (LED_ID_CAMERA_IR != id))
     {
-        return 0;
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
+        return LED_ERR_INVALID_PARAM;
     }
-}
-
-static void led_transfer_command_to_lp5562_program(Led_Config *led_config, char program[3][LED_LP5562_COMMAND_LEN])
-{
-	int index = 0;
-	uint16_t command_num = 0;
-	uint16_t on_wait_loop_time = 0;
-	uint16_t on_wait_remainder_step = 0;
-	uint16_t off_wait_loop_time = 0;
-	uint16_t off_wait_remainder_step = 0;
-	uint16_t off_wait1_loop_time = 0;
-	uint16_t off_wait1_remainder_step = 0;
-	uint16_t off_wait2_loop_time = 0;
-	uint16_t off_wait2_remainder_step = 0;
-	uint16_t count_repeat = 0;
-	uint16_t loop_num = 0;
-
-	memset(program,0,sizeof(char)*3*LED_LP5562_COMMAND_LEN);
-
-	if (Led_BLINK == led_config->action.act_type)
-	{
-		//transfer blink to LP5562 command
-    	on_wait_loop_time = (led_config->action.on_time*10) / (LED_LP5562_WAIT_CMD_MAX_STEP * LED_LP5562_WAIT_CMD_STEP_TIME);
-    	on_wait_remainder_step = ((led_config->action.on_time*10) % (LED_LP5562_WAIT_CMD_MAX_STEP * LED_LP5562_WAIT_CMD_STEP_TIME)) / LED_LP5562_WAIT_CMD_STEP_TIME;
-
-    	off_wait_loop_time = (led_config->action.off_time*10) / (LED_LP5562_WAIT_CMD_MAX_STEP * LED_LP5562_WAIT_CMD_STEP_TIME);
-    	off_wait_remainder_step = ((led_config->action.off_time*10) % (LED_LP5562_WAIT_CMD_MAX_STEP * LED_LP5562_WAIT_CMD_STEP_TIME)) / LED_LP5562_WAIT_CMD_STEP_TIME;
-    	for (index = 0; index < 3; index++)
-    	{
-			command_num = 0;
-
-        	snprintf(program[index],LED_LP5562_COMMAND_LEN,"40%02X",led_config->led_chip.channel[index].pwm);//turn on
-        	command_num++;
-        	if (on_wait_loop_time > 0)
-        	{
-            	//wait
-            	snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%02X00",LED_LP5562_WAIT_CMD_MAX_STEP | (1<<6));
-            	command_num++;
-            	if (on_wait_loop_time > 1)
-            	{
-                	//loop
-                	loop_num = on_wait_loop_time;
-                	loop_num = (loop_num - 1) << 7;
-                	loop_num = loop_num | 0xA000 | (command_num -1);
-                	snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%04X",loop_num);
-                	command_num++;
-            	}
-        	}
-        	if (on_wait_remainder_step > 0)
-        	{
-            	snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%02X00",on_wait_remainder_step | (1<<6));
-            	command_num++;
-        	}
-
-        	//turn off
-        	snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"4000");
-        	command_num++;
-        	if (off_wait_loop_time > 0)
-        	{
-            	//wait
-            	snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%02X00",LED_LP5562_WAIT_CMD_MAX_STEP | (1<<6));
-            	command_num++;
-            	if (off_wait_loop_time > 1)
-            	{
-                	loop_num = off_wait_loop_time;
-
-                	loop_num = (loop_num - 1) << 7;
-                	loop_num = loop_num | 0xA000 | (command_num -1);
-                	snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%04X",loop_num);
-                	command_num++;
-            	}
-        	}
-        	if (off_wait_remainder_step > 0)
-        	{
-            	snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%02X00",off_wait_remainder_step | (1<<6));
-            	command_num++;
-        	}
-
-        	//goto start
-        	snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"A000D000");
-    	}		
-	}
-	else if (Led_SEQ_BLINK == led_config->action.act_type)
-	{
-		on_wait_loop_time = (led_config->action.on_time * 10)/(LED_LP5562_WAIT_CMD_STEP_TIME * LED_LP5562_WAIT_CMD_MAX_STEP);
-		on_wait_remainder_step = ((led_config->action.on_time * 10)%(LED_LP5562_WAIT_CMD_STEP_TIME * LED_LP5562_WAIT_CMD_MAX_STEP)) / LED_LP5562_WAIT_CMD_STEP_TIME;
-		off_wait1_loop_time = (led_config->action.off1_time * 10)/(LED_LP5562_WAIT_CMD_STEP_TIME * LED_LP5562_WAIT_CMD_MAX_STEP);
-		off_wait1_remainder_step = ((led_config->action.off1_time * 10)%(LED_LP5562_WAIT_CMD_STEP_TIME * LED_LP5562_WAIT_CMD_MAX_STEP)) / LED_LP5562_WAIT_CMD_STEP_TIME;
-
-		off_wait2_loop_time = (led_config->action.off2_time * 10)/(LED_LP5562_WAIT_CMD_STEP_TIME * LED_LP5562_WAIT_CMD_MAX_STEP);
-		off_wait2_remainder_step = ((led_config->action.off2_time * 10)%(LED_LP5562_WAIT_CMD_STEP_TIME * LED_LP5562_WAIT_CMD_MAX_STEP)) / LED_LP5562_WAIT_CMD_STEP_TIME;
-		for (index = 0; index < 3; index++)
-		{
-
-			command_num = 0;
-			snprintf(program[index],LED_LP5562_COMMAND_LEN,"40%02X",led_config->led_chip.channel[index].pwm);//turn on
-			command_num++;
-			if (on_wait_loop_time > 0)
-			{
-				//wait
-				snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%02X00",LED_LP5562_WAIT_CMD_MAX_STEP | (1<<6));
-				command_num++;
-				if (on_wait_loop_time > 1)
-				{
-					//loop wait command
-					loop_num = on_wait_loop_time;
-					loop_num = (loop_num - 1) << 7;
-					loop_num = loop_num | 0xA000 | (command_num - 1);
-					snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%04X",loop_num);
-					command_num++;
-				}
-			}
-
-			if (on_wait_remainder_step)
-			{
-				snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%02X00",on_wait_remainder_step | (1<<6));
-				command_num++;
-			}
-
-			//turn off1
-			snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"4000");
-			command_num++;
-			if (off_wait1_loop_time > 0)
-			{
-				//wait
-				snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%02X00",LED_LP5562_WAIT_CMD_MAX_STEP | (1<<6));
-				command_num++;
-				if (off_wait1_loop_time > 1)
-				{
-					loop_num = off_wait1_loop_time;
-					loop_num = (loop_num - 1) << 7;
-					loop_num = loop_num | 0xA000 | (command_num - 1);
-					snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%04X",loop_num);
-					command_num++;
-				}
-			}
-
-			if (off_wait1_remainder_step > 0)
-			{
-				snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%02X00",off_wait1_remainder_step | (1<<6));
-				command_num++;
-			}
-
-			//count
-			if (led_config->action.count > 1)
-			{
-				count_repeat = (uint16_t)(led_config->action.count-1);
-				count_repeat = count_repeat << 7;
-				count_repeat = count_repeat | 0xA000;
-				snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%04X",count_repeat);
-				command_num++;
-			}
-
-			//turn off2
-			snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"4000");
-			command_num++;
-			if (off_wait2_loop_time > 0)
-			{
-				//wait
-				snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%02X00",LED_LP5562_WAIT_CMD_MAX_STEP | (1<<6));
-				command_num++;
-				if (off_wait2_loop_time > 1)
-				{
-					loop_num = off_wait2_loop_time;
-
-					loop_num = (loop_num - 1) << 7;
-					loop_num = loop_num | 0xA000 | (command_num - 1);
-					snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%04X",loop_num);
-					command_num++;
-				}
-			}
-			if (off_wait2_remainder_step > 0)
-			{
-				snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"%02X00",off_wait2_remainder_step | (1<<6));
-				command_num++;
-			}
-
-			//goto start
-			snprintf(program[index]+strlen(program[index]),LED_LP5562_COMMAND_LEN-strlen(program[index]),"A000D000");
-		}
-	}
-	else if (Led_OFF == led_config->action.act_type)
-	{
-		for (index = 0; index < 3; index++)
-		{
-			snprintf(program[index],LED_LP5562_COMMAND_LEN,"4000D000");
-		}
-	}
-	else
-	{
-		for (index = 0; index < 3; index++)
-		{
-			snprintf(program[index],LED_LP5562_COMMAND_LEN,"40%02XD000",led_config->led_chip.channel[index].pwm);
-		}
-	}
-
-	return;
-}
-
-static int led_apply_lp5562_setting(Led_Config *led_config)
-{
-    char command[512] = {0};
-	char lp5562_program[3][LED_LP5562_COMMAND_LEN] = {{0}};
-    int lp5562_fd = -1;
-    long funcs = 0;
-    int try_times = 3;
-    int i = 0;
 
-	//transfer command to LP5562's program
-	led_transfer_command_to_lp5562_program(led_config,lp5562_program);
-
-	//apply current to LP5562
-    do
+    backend = led_get_backend(id);
+    if (!backend)
     {
-        lp5562_fd = open(LED_LP5562_I2C_DEVICE,O_RDWR);
-        if (lp5562_fd < 0)
+        //nothing to queue on, the apply reports the error
+        ret = led_applySettings(id);
+        if (cb)
         {
-            usleep(5000);
+            cb(id,ret,ctx);
         }
-        try_times--;
-    }while((lp5562_fd < 0) && (try_times > 0));
-
-    if (lp5562_fd < 0)
-    {
-        LEDMGR_LOG_ERROR("open  led I2C error\n");
-        return -1;
+        return LED_ERR_NONE;
     }
+    slot = &led_async_slot[id];
+    worker = &led_async_worker[backend->device];
 
-    if ((ioctl(lp5562_fd, I2C_FUNCS, &funcs) >=0) && (ioctl(lp5562_fd, I2C_SLAVE_FORCE, 0x30) >= 0))
+    pthread_mutex_lock(&led_async_mutex);
+    if (!worker->started)
     {
-        i2c_smbus_write_byte_data(lp5562_fd, LED_LP5562_R_CURRENT_REG, led_config->led_chip.channel[0].current);
-        i2c_smbus_write_byte_data(lp5562_fd, LED_LP5562_G_CURRENT_REG, led_config->led_chip.channel[1].current);
-        i2c_smbus_write_byte_data(lp5562_fd, LED_LP5562_B_CURRENT_REG, led_config->led_chip.channel[2].current);
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_DETACHED);
+        worker->started = (0 == pthread_create(&thread,&attr,led_async_thread,(void *)(intptr_t)backend->device));
+        pthread_attr_destroy(&attr);
     }
-    else
+    if (!worker->started)
     {
-        close(lp5562_fd);
-        return -1;
+        pthread_mutex_unlock(&led_async_mutex);
+        LEDMGR_LOG_WARN(" %s create worker of id %d failed, apply now\n",__FUNCTION__, id);
+        ret = led_applySettings(id);
+        if (cb)
+        {
+            cb(id,ret,ctx);
+        }
+        return LED_ERR_NONE;
     }
-
-    //apply commands to lp5562 chip
-    //firstly stop engine
-    snprintf(command,sizeof(command),"/bin/echo 0 > %s/run_engine",LED_LP5562_DEVICE_PATH);
-    system(command);
-    for (i = 0; i < 3; i++)
+    if (slot->count >= LED_ASYNC_MAX_WAITERS)
     {
-        //select engine
-        snprintf(command,sizeof(command),"/bin/echo %d > %s/select_engine",i+1,LED_LP5562_DEVICE_PATH);
-        system(command);
-        //set engine mod
-        snprintf(command,sizeof(command),"/bin/echo \"RGB\" > %s/engine_mux",LED_LP5562_DEVICE_PATH);
-        system(command);
-        //loading command
-        snprintf(command,sizeof(command),"/bin/echo 1 > %s/firmware/lp5562/loading",LED_LP5562_DEVICE_PATH);
-        system(command);
-        //snprintf(command,sizeof(command),"/bin/echo \"%s\" > %s/firmware/lp5562/data",lp5562_program[i],LED_LP5562_DEVICE_PATH);
-        //system(command);
-        v_secure_system("/bin/echo %s > "LED_LP5562_DEVICE_PATH"/firmware/lp5562/data",lp5562_program[i]);
-        //v_secure_system("/bin/echo %s > %s/firmware/lp5562/data",lp5562_program[i],LED_LP5562_DEVICE_PATH);
-        //end loading
-        snprintf(command,sizeof(command),"/bin/echo 0 > %s/firmware/lp5562/loading",LED_LP5562_DEVICE_PATH);
-        system(command);
+        pthread_mutex_unlock(&led_async_mutex);
+        snprintf(error_msg[LED_ERR_GENERAL],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] %d applies of id %d already queued\n",__FUNCTION__,__LINE__,LED_ASYNC_MAX_WAITERS,id);
+        return LED_ERR_GENERAL;
     }
-    //run engine
-    snprintf(command,sizeof(command),"/bin/echo 1 > %s/run_engine",LED_LP5562_DEVICE_PATH);
-    system(command);
-    close(lp5562_fd);
+    slot->waiter[slot->count].cb = cb;
+    slot->waiter[slot->count].ctx = ctx;
+    slot->count++;
+    slot->pending = 1;
+    pthread_cond_signal(&worker->cond);
+    pthread_mutex_unlock(&led_async_mutex);
 
-    return 0;
+    return LED_ERR_NONE;
 }
 
-static int led_apply_aw21009_setting(Led_Config *led_config)
+ledError_t led_setOption(ledOption_t option, int value)
 {
-    char command[512] = {0};
-    char led_color[10] = {0};
-    char led_brightness[10] = {0};
+    int id = LED_ID_CAMERA_FRONT_PANEL;
 
-    snprintf(led_color,sizeof(led_color),"0x%02x%02x%02x", led_config->led_chip.channel[0].current, led_config->led_chip.channel[1].current, led_config->led_chip.channel[2].current);
-    snprintf(led_brightness,sizeof(led_brightness),"0x%02x%02x%02x", led_config->led_chip.channel[0].pwm, led_config->led_chip.channel[1].pwm, led_config->led_chip.channel[2].pwm);
+    LEDMGR_LOG_DEBUG(" %s option: %d value: %d\n",__FUNCTION__, option, value);
 
-    if (Led_ON == led_config->action.act_type)
-    {
-        snprintf(command,sizeof(command),"/bin/echo 0x00 %s %s > %s &", led_color, led_brightness, RGBCOLOR);
-        system(command);
-    }
-    if (Led_OFF == led_config->action.act_type)
-    {
-        snprintf(command,sizeof(command),"echo 0x00 0x000000 0x000000 > %s &", RGBCOLOR);
-        system(command);
-    }
-    if (Led_BLINK == led_config->action.act_type)
-    {
-        snprintf(command,sizeof(command),"/etc/led_functions.sh brightness_blink %d:%d,%d:%d,%d:%d %d %d &", led_config->led_chip.channel[0].current, led_config->led_chip.channel[0].pwm, led_config->led_chip.channel[1].current, led_config->led_chip.channel[1].pwm, led_config->led_chip.channel[2].current, led_config->led_chip.channel[2].pwm, (led_config->action.on_time)*1000, (led_config->action.off_time)*1000);
-        system(command);
-    }
-    if (Led_SEQ_BLINK == led_config->action.act_type)
+    switch (option)
     {
-        snprintf(command,sizeof(command),"/etc/led_functions.sh sequence_blink %d:%d,%d:%d,%d:%d  %d %d %d %d &",led_config->led_chip.channel[0].current, led_config->led_chip.channel[0].pwm, led_config->led_chip.channel[1].current, led_config->led_chip.channel[1].pwm, led_config->led_chip.channel[2].current, led_config->led_chip.channel[2].pwm, (led_config->action.on_time)*1000, (led_config->action.off1_time)*1000, led_config->action.count, (led_config->action.off2_time)*1000);
-        system(command);
+        case LED_OPT_CONFIG_PERSISTENCE:
+            led_config_persistence = value ? 1 : 0;
+            //write out what has been configured so far, so the file matches memory from now on
+            for (id = LED_ID_CAMERA_FRONT_PANEL; led_config_persistence && (id < LED_ID_MAX); id++)
+            {
+                if (led_txn_owned((ledId_t)id))
+                {
+                    //written when the update is committed
+                    continue;
+                }
+                led_config_lock((ledId_t)id);
+                if (led_config_record((ledId_t)id)->loaded)
+                {
+                    led_save_config_file((ledId_t)id,&led_config_record((ledId_t)id)->config);
+                }
+                led_config_unlock((ledId_t)id);
+            }
+            break;
+        case LED_OPT_LP5562_I2C_LOAD:
+            led_lp5562_i2c_load = value ? 1 : 0;
+            break;
+        case LED_OPT_AW210XX_PATTERN:
+            led_aw210xx_pattern = value ? 1 : 0;
+            break;
+        case LED_OPT_PARALLEL_APPLY:
+            led_parallel_apply = value ? 1 : 0;
+            break;
+        default:
+            snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] option %d is illegal\n",__FUNCTION__,__LINE__,option);
+            return LED_ERR_INVALID_PARAM;
     }
 
-    return 0;
+    return LED_ERR_NONE;
 }
 
-ledError_t led_applySettings(ledId_t id)
+ledError_t led_getRunning(ledId_t id, int *running)
 {
-    char led_config_file[LED_CONFIG_FILE_NAME_LENGTH] = {0};
-    Led_Config led_config;
-    int config_fd = -1;
-    int ret = -1;
+    Led_Hw_Image *hw = NULL;
 
-    LEDMGR_LOG_DEBUG(" %s id: %d \n",__FUNCTION__, id);
-
-    //check parameter 
+    //check parameter
     if ((LED_ID_CAMERA_FRONT_PANEL != id) &&(LED_ID_XW_FRONT_PANEL != id) && (LED_ID_CAMERA_IR != id))
     {
         snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] id %d is illegal\n",__FUNCTION__,__LINE__,id);
         return LED_ERR_INVALID_PARAM;
     }
 
-    //open LED config
-    snprintf(led_config_file,sizeof(led_config_file),"%s%s%d",LED_CONFIG_FILE_PATH,LED_CONFIG_FILE_PREFIX,id);
-    config_fd = open(led_config_file,O_RDONLY);
-    if (config_fd < 0)
+    if (NULL == running)
     {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, open config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] running is NULL\n",__FUNCTION__,__LINE__);
+        return LED_ERR_INVALID_PARAM;
     }
 
-    //lock LED config file
-    if (lock_led_config(config_fd))
+    *running = 0;
+    //only AW210XX blinks are stepped by a thread of the caller
+    if (LED_ID_CAMERA_FRONT_PANEL == id)
     {
-        //lock failed
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, lock config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        hw = led_hw_lock(LED_HW_AW210XX);
+        //a blink superseded by another apply is stopped on its next step
+        *running = (led_aw210xx_blink.count > 0) && (led_aw210xx_blink.generation == hw->aw210xx_generation);
+        led_hw_unlock(hw,LED_HW_AW210XX);
     }
 
-    //read LED config file
-    if (read_led_config(config_fd,&led_config))
+    return LED_ERR_NONE;
+}
+
+ledError_t led_getStats(ledStats_t *stats)
+{
+    ledStats_t *shared = NULL;
+
+    if (NULL == stats)
     {
-        //read  failed
-        flock(config_fd,LOCK_UN);
-        close(config_fd);
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, read config file error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] stats is NULL\n",__FUNCTION__,__LINE__);
+        return LED_ERR_INVALID_PARAM;
     }
-    
-    //read success, unlock and close LED config file
-    flock(config_fd,LOCK_UN);
-    close(config_fd);
-   
-	//take action 
-    if ((LED_ID_CAMERA_FRONT_PANEL == id) || (LED_ID_XW_FRONT_PANEL == id))
+
+    shared = led_stats();
+    stats->program_cache_hits = __atomic_load_n(&shared->program_cache_hits,__ATOMIC_RELAXED);
+    stats->program_cache_misses = __atomic_load_n(&shared->program_cache_misses,__ATOMIC_RELAXED);
+    stats->engine_reload_skips = __atomic_load_n(&shared->engine_reload_skips,__ATOMIC_RELAXED);
+    stats->apply_noops = __atomic_load_n(&shared->apply_noops,__ATOMIC_RELAXED);
+    stats->writes_avoided = __atomic_load_n(&shared->writes_avoided,__ATOMIC_RELAXED);
+    stats->config_lock_retries = __atomic_load_n(&shared->config_lock_retries,__ATOMIC_RELAXED);
+    stats->open_retries = __atomic_load_n(&shared->open_retries,__ATOMIC_RELAXED);
+
+    return LED_ERR_NONE;
+}
+
+ledError_t led_getLatency(ledLatencyId_t which, ledLatency_t *latency)
+{
+    ledLatency_t *shared = NULL;
+    int bucket = 0;
+
+    if ((which < LED_LATENCY_INIT) || (which >= LED_LATENCY_MAX))
     {
-        if (0 == access(LEDS_CHIP_AW210XX_FILE, F_OK))
-        {
-            system("kill -9 $(ps | grep led_functions | grep -v grep | awk -F ' ' '{print $1}') > /dev/null 2> /dev/null");
-            ret = led_apply_aw21009_setting(&led_config);
-        }
-        else
-        {
-            ret = led_apply_lp5562_setting(&led_config);
-        }
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] entry point %d is illegal\n",__FUNCTION__,__LINE__,which);
+        return LED_ERR_INVALID_PARAM;
     }
-    else
+    if (NULL == latency)
     {
-        ret = led_apply_irled_setting(&led_config);
+        snprintf(error_msg[LED_ERR_INVALID_PARAM],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] latency is NULL\n",__FUNCTION__,__LINE__);
+        return LED_ERR_INVALID_PARAM;
     }
 
-    if (ret)
-    {
-        snprintf(error_msg[LED_ERR_UNKNOWN],LED_ERROR_MSG_MAX_LENGTH,"[%s:%d] Unknown Error, apply setting to device error\n",__FUNCTION__,__LINE__);
-        return LED_ERR_UNKNOWN;
-    }
-    else
+    pthread_once(&led_config_shm_once,led_config_shm_map);
+    shared = &led_config_shm->latency[which];
+    //counters are read one by one, a call recorded meanwhile may show in some of them only
+    latency->count = __atomic_load_n(&shared->count,__ATOMIC_RELAXED);
+    latency->max_us = __atomic_load_n(&shared->max_us,__ATOMIC_RELAXED);
+    latency->total_us = __atomic_load_n(&shared->total_us,__ATOMIC_RELAXED);
+    for (bucket = 0; bucket < LED_LATENCY_BUCKETS; bucket++)
     {
-        return LED_ERR_NONE;
+        latency->bucket[bucket] = __atomic_load_n(&shared->bucket[bucket],__ATOMIC_RELAXED);
     }
+
+    return LED_ERR_NONE;
 }
 
-ledError_t led_applyAllSettings()
+const char* led_getLatencyName(ledLatencyId_t which)
 {
-    int id = LED_ID_CAMERA_FRONT_PANEL;
-    ledError_t ret = LED_ERR_NONE;
- 
-    LEDMGR_LOG_DEBUG(" %s \n",__FUNCTION__);
-    for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++)
+    static const char *name[LED_LATENCY_MAX] = {
+        "led_init",
+        "led_reset",
+        "led_setEnable",
+        "led_setColor",
+        "led_setBrightness",
+        "led_setIrBrightness",
+        "led_setBlink",
+        "led_setBlinkSequence",
+        "led_setFade",
+        "led_setBreathe",
+        "led_setPattern",
+        "led_setColorSequence",
+        "led_setOnOff",
+        "led_commitUpdate",
+        "led_applySettings",
+        "backend aw210xx",
+        "backend lp5562",
+        "backend irled",
+        "backend xw",
+        "backend sim",
+    };
+
+    if ((which < LED_LATENCY_INIT) || (which >= LED_LATENCY_MAX))
     {
-        ret = led_applySettings((ledId_t)id);
-        if (LED_ERR_NONE != ret)
-        {
-            return ret;
-        }
+        return "unknown";
     }
-    return LED_ERR_NONE;
-}
 
+    return name[which];
+}
 
 const char* led_getErrorMsg(ledError_t err)
 {
@@ -45,6 +45,90 @@ typedef enum _ledId_t {
   LED_ID_MAX
 }ledId_t;
 
+/* HAL options */
+typedef enum _ledOption_t {
+  LED_OPT_CONFIG_PERSISTENCE = 0,   /* 1 - write every config change back to the led config file, 0 - keep config in memory only (default) */
+  LED_OPT_LP5562_I2C_LOAD,          /* 1 - load LP5562 engine programs directly over I2C, 0 - load them through the driver's sysfs interface (default) */
+  LED_OPT_AW210XX_PATTERN,          /* 1 - run AW210XX blinks on the chip's pattern controller where the timing allows it, 0 - run them in software (default) */
+  LED_OPT_PARALLEL_APPLY,           /* 1 - apply every led on its own thread in led_applyAllSettings (default), 0 - one led after the other */
+  LED_OPT_MAX
+}ledOption_t;
+
+/* Committed settings of a led, see led_getSettings */
+typedef struct _ledSettings_t {
+  int enable;                       /* 1 - led enabled, 0 - led disabled */
+  int on;                           /* 1 - led is on or blinking, 0 - led is off */
+  uint8_t color[3];                 /* R, G, B color */
+  uint8_t brightness[3];            /* R, G, B brightness, brightness[0] for IR led */
+}ledSettings_t;
+
+/* max steps of a led pattern, see led_setPattern */
+#define LED_PATTERN_MAX_STEPS 16
+
+/* Step of a led pattern, see led_setPattern */
+typedef struct _ledPatternStep_t {
+  uint8_t pwm[3];                   /* R, G, B pwm, 0~255 */
+  uint32_t duration;                /* time of the step in ms, rounded down to 15.6ms */
+}ledPatternStep_t;
+
+/* Step of a led color sequence, see led_setColorSequence */
+typedef struct _ledColorStep_t {
+  uint8_t color[3];                 /* R, G, B color */
+  uint8_t brightness[3];            /* R, G, B brightness */
+  uint32_t duration;                /* time of the step in ms, rounded down to 15.6ms */
+}ledColorStep_t;
+
+/* Called with the result of an asynchronous apply, see led_applySettingsAsync */
+typedef void (*ledApplyCallback_t)(ledId_t id, ledError_t result, void *ctx);
+
+/* HAL counters, shared by all processes using the led hal, see led_getStats */
+typedef struct _ledStats_t {
+  uint32_t program_cache_hits;      /* LP5562 programs taken from the program cache */
+  uint32_t program_cache_misses;    /* LP5562 programs compiled */
+  uint32_t engine_reload_skips;     /* LP5562 applies which left the running engine programs alone */
+  uint32_t apply_noops;             /* applies which found the device already showing the config */
+  uint32_t writes_avoided;          /* register and device file writes not done because the device already held the value */
+  uint32_t config_lock_retries;     /* waits for the lock of a led config file */
+  uint32_t open_retries;            /* waits for a sysfs attribute or the I2C bus to open */
+}ledStats_t;
+
+/* Timed entry points of the led hal and backends, see led_getLatency */
+typedef enum _ledLatencyId_t {
+  LED_LATENCY_INIT = 0,             /* led_init */
+  LED_LATENCY_RESET,                /* led_reset */
+  LED_LATENCY_SET_ENABLE,           /* led_setEnable */
+  LED_LATENCY_SET_COLOR,            /* led_setColor */
+  LED_LATENCY_SET_BRIGHTNESS,       /* led_setBrightness */
+  LED_LATENCY_SET_IR_BRIGHTNESS,    /* led_setIrBrightness */
+  LED_LATENCY_SET_BLINK,            /* led_setBlink */
+  LED_LATENCY_SET_BLINK_SEQUENCE,   /* led_setBlinkSequence */
+  LED_LATENCY_SET_FADE,             /* led_setFade */
+  LED_LATENCY_SET_BREATHE,          /* led_setBreathe */
+  LED_LATENCY_SET_PATTERN,          /* led_setPattern */
+  LED_LATENCY_SET_COLOR_SEQUENCE,   /* led_setColorSequence */
+  LED_LATENCY_SET_ONOFF,            /* led_setOnOff */
+  LED_LATENCY_COMMIT_UPDATE,        /* led_commitUpdate */
+  LED_LATENCY_APPLY_SETTINGS,       /* led_applySettings, also for every led of led_applyAllSettings */
+  LED_LATENCY_BACKEND_AW210XX,      /* applies to the AW210XX led driver */
+  LED_LATENCY_BACKEND_LP5562,       /* applies to the LP5562 led driver */
+  LED_LATENCY_BACKEND_IRLED,        /* applies to the IR led */
+  LED_LATENCY_BACKEND_XW,           /* applies to the XW front panel led */
+  LED_LATENCY_BACKEND_SIM,          /* applies to the simulated device */
+  LED_LATENCY_MAX
+}ledLatencyId_t;
+
+/* Latency buckets, bucket 0 holds calls under LED_LATENCY_BUCKET_MIN_US, every next bucket up to twice as long */
+#define LED_LATENCY_BUCKETS 20
+#define LED_LATENCY_BUCKET_MIN_US 16
+
+/* Latency histogram of an entry point, shared by all processes using the led hal, see led_getLatency */
+typedef struct _ledLatency_t {
+  uint32_t count;                   /* calls timed */
+  uint32_t max_us;                  /* longest call in us */
+  uint64_t total_us;                /* time of all calls in us */
+  uint32_t bucket[LED_LATENCY_BUCKETS]; /* calls by time, bucket n from (LED_LATENCY_BUCKET_MIN_US << n) / 2 up to LED_LATENCY_BUCKET_MIN_US << n us, the last bucket also holds longer calls */
+}ledLatency_t;
+
 /**
  * @brief Initialize led.
  * This function should be call once before the functions in this API can be used.
@@ -68,14 +152,25 @@ ledError_t led_reset(ledId_t id);
 
 /**
  * @brief Reset all leds to default.
+ * Every led is reset, also when another led fails.
  *
  * @param [in]  :  Identifier of a led.
  * @param [out] :  None.
  *
- * @return Error Code:  If error code is returned then resetall failed.
+ * @return Error Code:  If error code is returned then resetall failed, the first error of the leds.
  */
 ledError_t led_resetAll();
 
+/**
+ * @brief Reset all leds to default, reporting the result of every led.
+ *
+ * @param [in]  :  None.
+ * @param [out] status :  result of every led, indexed by led id.
+ *
+ * @return Error Code:  If error code is returned then reset of a led failed, the first error of the leds.
+ */
+ledError_t led_resetAllEx(ledError_t status[LED_ID_MAX]);
+
 /**
  * @brief Enable or disable a led.
  *
@@ -113,6 +208,20 @@ ledError_t led_setColor(ledId_t id, uint8_t R, uint8_t G, uint8_t B);
  */
 ledError_t led_setBrightness(ledId_t id, uint8_t R, uint8_t G, uint8_t B);
 
+/**
+ * @brief Set brightness of the IR led and the time to ramp to it.
+ * When applied, the IR led ramps from the brightness it shows to the new one, so switching it does not flash.
+ * The ramp time is kept and also used when the IR led is turned on or off.
+ *
+ * @param [in]  id        :  Identifier of a led, LED_ID_CAMERA_IR.
+ * @param [in]  brightness:  0-255 brightness
+ * @param [in]  ramptime  :  ramp time in ms, 0 - change at once
+ * @param [out]           :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_setIrBrightness(ledId_t id, uint8_t brightness, uint32_t ramptime);
+
 /**
  * @brief Set led to blink.
  *
@@ -139,6 +248,61 @@ ledError_t led_setBlink(ledId_t id, uint32_t ontime, uint32_t offtime);
  */
 ledError_t led_setBlinkSequence(ledId_t id, uint32_t ontime, uint32_t offtime1, uint32_t count, uint32_t offtime2);
 
+/**
+ * @brief Set led to fade in or out. The fade is run by the led chip where it supports pwm ramps,
+ * other leds switch on or off at once.
+ *
+ * @param [in]  id      :  Identifier of a led.
+ * @param [in]  fadein  :  1 - fade from off to on, 0 - fade from on to off
+ * @param [in]  fadetime:  fade time in milliseconds (ms)
+ * @param [out]         :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_setFade(ledId_t id, int fadein, uint32_t fadetime);
+
+/**
+ * @brief Set led to breathe, fading in and out repeatedly. The breathing is run by the led chip where it
+ * supports pwm ramps, other leds blink instead.
+ *
+ * @param [in]  id      :  Identifier of a led.
+ * @param [in]  risetime:  fade in time in milliseconds (ms)
+ * @param [in]  falltime:  fade out time in milliseconds (ms)
+ * @param [out]         :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_setBreathe(ledId_t id, uint32_t risetime, uint32_t falltime);
+
+/**
+ * @brief Set led to run a pattern, taking the pwm of every step for the time of the step and repeating.
+ * The pattern is run by the led chip, steps of the same pwm are merged and repeated sequences of steps
+ * are looped, a pattern which still does not fit in the program memory of the chip is rejected.
+ *
+ * @param [in]  id      :  Identifier of a led.
+ * @param [in]  steps   :  steps of the pattern.
+ * @param [in]  n       :  number of steps, 1~LED_PATTERN_MAX_STEPS.
+ * @param [out]         :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_setPattern(ledId_t id, const ledPatternStep_t *steps, uint32_t n);
+
+/**
+ * @brief Set led to cycle through colors, showing every color for the time of its step and repeating.
+ * The sequence is run as a pattern by the led chip, see led_setPattern. The chip keeps one color per channel
+ * while the pattern runs, every channel is set to the largest color of the steps and the brightness of
+ * the steps is scaled to match.
+ *
+ * @param [in]  id      :  Identifier of a led.
+ * @param [in]  steps   :  steps of the sequence.
+ * @param [in]  n       :  number of steps, 1~LED_PATTERN_MAX_STEPS.
+ * @param [out]         :  None.
+ *
+ * @return Error Code:  If error code is returned then failed, LED_ERR_OPERATION_NOT_SUPPORTED if the led chip can not run patterns.
+ */
+ledError_t led_setColorSequence(ledId_t id, const ledColorStep_t *steps, uint32_t n);
+
 //ledError_t led_setEngineMode(unsigned int index, char* mode); //mode is RGB/W
 
 /**
@@ -166,14 +330,285 @@ ledError_t led_applySettings(ledId_t id);
 /**
  * @brief Apply configured settings for all led's
  * This API to be called after doing required configuration for all leds and this will apply/run the engine.
+ * Every led is applied, also when another led fails. With LED_OPT_PARALLEL_APPLY the leds are applied in parallel.
  *
  * @param [in]  id   :  Identifier of a led.
  * @param [out]    :  None.
  *
- * @return Error Code:  If error code is returned then failed.
+ * @return Error Code:  If error code is returned then failed, the first error of the leds.
  */
 ledError_t led_applyAllSettings();
 
+/**
+ * @brief Apply configured settings for a led without waiting for the device
+ * The apply is queued to a worker thread of the device driving the led, cb is called on that thread with the result.
+ * Applies of a led queued before the worker gets to it are served by a single apply of the newest settings,
+ * the callbacks of all of them get its result.
+ *
+ * @param [in]  id   :  Identifier of a led.
+ * @param [in]  cb   :  called with the result of the apply, may be NULL.
+ * @param [in]  ctx  :  passed to cb.
+ * @param [out]      :  None.
+ *
+ * @return Error Code:  If error code is returned then the apply was not queued and cb is not called.
+ */
+ledError_t led_applySettingsAsync(ledId_t id, ledApplyCallback_t cb, void *ctx);
+
+/**
+ * @brief Apply configured settings for all led's, reporting the result of every led.
+ *
+ * @param [in]  :  None.
+ * @param [out] status :  result of every led, indexed by led id.
+ *
+ * @return Error Code:  If error code is returned then applying a led failed, the first error of the leds.
+ */
+ledError_t led_applyAllSettingsEx(ledError_t status[LED_ID_MAX]);
+
+/**
+ * @brief Set a HAL option
+ * This API to be called to change the behaviour of the led hal, see ledOption_t.
+ *
+ * @param [in]  option :  Option to set.
+ * @param [in]  value  :  Value of the option.
+ * @param [out]        :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_setOption(ledOption_t option, int value);
+
+/**
+ * @brief Get committed settings of a led.
+ * This API never blocks on writers, it can be called from any process using the led hal.
+ *
+ * @param [in]  id       :  Identifier of a led.
+ * @param [out] settings :  Settings of the led.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_getSettings(ledId_t id, ledSettings_t *settings);
+
+/**
+ * @brief Check whether a led effect is run by this process.
+ * Some backends run blinks on a thread of the process which applied them, the blink stops when that process exits.
+ *
+ * @param [in]  id      :  Identifier of a led.
+ * @param [out] running :  1 a blink of the led is run by this process, 0 otherwise.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_getRunning(ledId_t id, int *running);
+
+/**
+ * @brief Begin an update of a led's config.
+ * The led is locked against other callers until led_commitUpdate or led_abortUpdate is called from the same thread.
+ * Stage changes with the led_stage* APIs, they are validated and published together on commit.
+ *
+ * @param [in]  id   :  Identifier of a led.
+ * @param [out]      :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_beginUpdate(ledId_t id);
+
+/**
+ * @brief Stage default config, see led_reset.
+ *
+ * @param [in]  id   :  Identifier of a led.
+ * @param [out]      :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_stageReset(ledId_t id);
+
+/**
+ * @brief Stage led state, see led_setEnable.
+ *
+ * @param [in]  id     :  Identifier of a led.
+ * @param [in]  enable :  1 - enable led, 0 - disable led.
+ * @param [out]        :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_stageEnable(ledId_t id, int enable);
+
+/**
+ * @brief Stage led color, see led_setColor.
+ *
+ * @param [in]  id   :  Identifier of a led.
+ * @param [in]  R    :  Red color.
+ * @param [in]  G    :  Green color.
+ * @param [in]  B    :  Blue color.
+ * @param [out]      :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_stageColor(ledId_t id, uint8_t R, uint8_t G, uint8_t B);
+
+/**
+ * @brief Stage led brightness, see led_setBrightness.
+ *
+ * @param [in]  id   :  Identifier of a led.
+ * @param [in]  R    :  Red brightness.
+ * @param [in]  G    :  Green brightness.
+ * @param [in]  B    :  Blue brightness.
+ * @param [out]      :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_stageBrightness(ledId_t id, uint8_t R, uint8_t G, uint8_t B);
+
+/**
+ * @brief Stage IR led brightness and ramp time, see led_setIrBrightness.
+ *
+ * @param [in]  id        :  Identifier of a led.
+ * @param [in]  brightness:  brightness.
+ * @param [in]  ramptime  :  ramp time in ms.
+ * @param [out]           :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_stageIrBrightness(ledId_t id, uint8_t brightness, uint32_t ramptime);
+
+/**
+ * @brief Stage blink action, see led_setBlink.
+ *
+ * @param [in]  id      :  Identifier of a led.
+ * @param [in]  ontime  :  on time in ms.
+ * @param [in]  offtime :  off time in ms.
+ * @param [out]         :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_stageBlink(ledId_t id, uint32_t ontime, uint32_t offtime);
+
+/**
+ * @brief Stage sequence blink action, see led_setBlinkSequence.
+ *
+ * @param [in]  id       :  Identifier of a led.
+ * @param [in]  ontime   :  on time in ms.
+ * @param [in]  offtime1 :  off time in ms between blinks.
+ * @param [in]  count    :  number of blinks.
+ * @param [in]  offtime2 :  off time in ms after the blinks.
+ * @param [out]          :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_stageBlinkSequence(ledId_t id, uint32_t ontime, uint32_t offtime1, uint32_t count, uint32_t offtime2);
+
+/**
+ * @brief Stage fade action, see led_setFade.
+ *
+ * @param [in]  id       :  Identifier of a led.
+ * @param [in]  fadein   :  1 - fade in, 0 - fade out.
+ * @param [in]  fadetime :  fade time in ms.
+ * @param [out]          :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_stageFade(ledId_t id, int fadein, uint32_t fadetime);
+
+/**
+ * @brief Stage breathe action, see led_setBreathe.
+ *
+ * @param [in]  id       :  Identifier of a led.
+ * @param [in]  risetime :  fade in time in ms.
+ * @param [in]  falltime :  fade out time in ms.
+ * @param [out]          :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_stageBreathe(ledId_t id, uint32_t risetime, uint32_t falltime);
+
+/**
+ * @brief Stage pattern action, see led_setPattern.
+ *
+ * @param [in]  id    :  Identifier of a led.
+ * @param [in]  steps :  steps of the pattern.
+ * @param [in]  n     :  number of steps.
+ * @param [out]       :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_stagePattern(ledId_t id, const ledPatternStep_t *steps, uint32_t n);
+
+/**
+ * @brief Stage color sequence, see led_setColorSequence.
+ * Stages the color and a pattern action.
+ *
+ * @param [in]  id    :  Identifier of a led.
+ * @param [in]  steps :  steps of the sequence.
+ * @param [in]  n     :  number of steps.
+ * @param [out]       :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_stageColorSequence(ledId_t id, const ledColorStep_t *steps, uint32_t n);
+
+/**
+ * @brief Stage on/off action, see led_setOnOff.
+ *
+ * @param [in]  id    :  Identifier of a led.
+ * @param [in]  onoff :  "on" or "off".
+ * @param [out]       :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_stageOnOff(ledId_t id, const char* onoff);
+
+/**
+ * @brief Commit the update of a led's config.
+ * The staged config is validated once and published as a whole, the led is unlocked in any case.
+ *
+ * @param [in]  id    :  Identifier of a led.
+ * @param [in]  apply :  1 - also apply the committed config to the device, 0 - publish only.
+ * @param [out]       :  None.
+ *
+ * @return Error Code:  If error code is returned then failed, the config is unchanged unless applying failed.
+ */
+ledError_t led_commitUpdate(ledId_t id, int apply);
+
+/**
+ * @brief Abort the update of a led's config.
+ * The staged changes are dropped and the led is unlocked.
+ *
+ * @param [in]  id   :  Identifier of a led.
+ * @param [out]      :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_abortUpdate(ledId_t id);
+
+/**
+ * @brief Get HAL counters
+ * This API to be called to check how often the led hal could reuse work, see ledStats_t.
+ *
+ * @param [out] stats :  Counters.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_getStats(ledStats_t *stats);
+
+/**
+ * @brief Get the latency histogram of an entry point
+ * This API to be called to check how long the led hal and its backends take, see ledLatency_t.
+ * The time includes waiting for other threads and processes updating the same led.
+ *
+ * @param [in]  which   :  Entry point.
+ * @param [out] latency :  Latency histogram.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledError_t led_getLatency(ledLatencyId_t which, ledLatency_t *latency);
+
+/**
+ * @brief Get the name of a timed entry point
+ *
+ * @param [in]  which :  Entry point.
+ *
+ * @return            :  Name of the entry point, "unknown" if illegal.
+ */
+const char* led_getLatencyName(ledLatencyId_t which);
+
 /**
  * @brief Gets error message for an error code
  * This API to be called to get error message for an error code
@@ -20,6 +20,7 @@
 */
  
 #include <stdio.h>
+#include <string.h>
 #include "ledhal.h"
 
 ledError_t led_init(ledId_t id)
@@ -40,6 +41,16 @@ ledError_t led_resetAll()
   return LED_ERR_NONE;
 }
 
+ledError_t led_resetAllEx(ledError_t status[LED_ID_MAX])
+{
+  int id = 0;
+
+  printf(" %s \n",__FUNCTION__);
+  for (id = 0; status && id < LED_ID_MAX; id++)
+    status[id] = LED_ERR_NONE;
+  return LED_ERR_NONE;
+}
+
 ledError_t led_setEnable(ledId_t id, int enable)
 {
   printf(" %s id: %d enable: %d\n",__FUNCTION__, id, enable);
@@ -58,6 +69,12 @@ ledError_t led_setBrightness(ledId_t id, uint8_t R, uint8_t G, uint8_t B)
   return LED_ERR_NONE;
 }
 
+ledError_t led_setIrBrightness(ledId_t id, uint8_t brightness, uint32_t ramptime)
+{
+  printf(" %s id: %d brightness: %d ramptime: %d\n",__FUNCTION__, id, brightness, ramptime);
+  return LED_ERR_NONE;
+}
+
 ledError_t led_setBlink(ledId_t id, uint32_t ontime, uint32_t offtime)
 {
   printf(" %s id: %d ontime: %d offtime: %d\n",__FUNCTION__, id, ontime, offtime);
@@ -70,6 +87,30 @@ ledError_t led_setBlinkSequence(ledId_t id, uint32_t ontime, uint32_t offtime1,
   return LED_ERR_NONE;
 }
 
+ledError_t led_setFade(ledId_t id, int fadein, uint32_t fadetime)
+{
+  printf(" %s id: %d fadein: %d fadetime: %d\n",__FUNCTION__, id, fadein, fadetime);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_setBreathe(ledId_t id, uint32_t risetime, uint32_t falltime)
+{
+  printf(" %s id: %d risetime: %d falltime: %d\n",__FUNCTION__, id, risetime, falltime);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_setPattern(ledId_t id, const ledPatternStep_t *steps, uint32_t n)
+{
+  printf(" %s id: %d steps: %p n: %d\n",__FUNCTION__, id, (const void *)steps, n);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_setColorSequence(ledId_t id, const ledColorStep_t *steps, uint32_t n)
+{
+  printf(" %s id: %d steps: %p n: %d\n",__FUNCTION__, id, (const void *)steps, n);
+  return LED_ERR_NONE;
+}
+
 ledError_t led_setOnOff(ledId_t id, const char* onoff)
 {
   printf(" %s id: %d onoff: %s \n",__FUNCTION__, id, onoff);
@@ -88,6 +129,157 @@ ledError_t led_applyAllSettings()
   return LED_ERR_NONE;
 }
 
+ledError_t led_applyAllSettingsEx(ledError_t status[LED_ID_MAX])
+{
+  int id = 0;
+
+  printf(" %s \n",__FUNCTION__);
+  for (id = 0; status && id < LED_ID_MAX; id++)
+    status[id] = LED_ERR_NONE;
+  return LED_ERR_NONE;
+}
+
+ledError_t led_applySettingsAsync(ledId_t id, ledApplyCallback_t cb, void *ctx)
+{
+  printf(" %s id: %d \n",__FUNCTION__, id);
+  if (cb)
+    cb(id, LED_ERR_NONE, ctx);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_setOption(ledOption_t option, int value)
+{
+  printf(" %s option: %d value: %d\n",__FUNCTION__, option, value);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_getSettings(ledId_t id, ledSettings_t *settings)
+{
+  printf(" %s id: %d\n",__FUNCTION__, id);
+  if (settings)
+    memset(settings, 0, sizeof(ledSettings_t));
+  return LED_ERR_NONE;
+}
+
+ledError_t led_getRunning(ledId_t id, int *running)
+{
+  printf(" %s id: %d\n",__FUNCTION__, id);
+  if (running)
+    *running = 0;
+  return LED_ERR_NONE;
+}
+
+ledError_t led_beginUpdate(ledId_t id)
+{
+  printf(" %s id: %d\n",__FUNCTION__, id);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_stageReset(ledId_t id)
+{
+  printf(" %s id: %d\n",__FUNCTION__, id);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_stageEnable(ledId_t id, int enable)
+{
+  printf(" %s id: %d enable: %d\n",__FUNCTION__, id, enable);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_stageColor(ledId_t id, uint8_t R, uint8_t G, uint8_t B)
+{
+  printf(" %s id: %d R: %d G: %d B: %d\n",__FUNCTION__, id, R, G, B);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_stageBrightness(ledId_t id, uint8_t R, uint8_t G, uint8_t B)
+{
+  printf(" %s id: %d R: %d G: %d B: %d\n",__FUNCTION__, id, R, G, B);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_stageIrBrightness(ledId_t id, uint8_t brightness, uint32_t ramptime)
+{
+  printf(" %s id: %d brightness: %d ramptime: %d\n",__FUNCTION__, id, brightness, ramptime);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_stageBlink(ledId_t id, uint32_t ontime, uint32_t offtime)
+{
+  printf(" %s id: %d ontime: %d offtime: %d\n",__FUNCTION__, id, ontime, offtime);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_stageBlinkSequence(ledId_t id, uint32_t ontime, uint32_t offtime1, uint32_t count, uint32_t offtime2)
+{
+  printf(" %s id: %d ontime: %d offtime1: %d count: %d offtime2: %d\n",__FUNCTION__, id, ontime, offtime1, count, offtime2);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_stageFade(ledId_t id, int fadein, uint32_t fadetime)
+{
+  printf(" %s id: %d fadein: %d fadetime: %d\n",__FUNCTION__, id, fadein, fadetime);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_stageBreathe(ledId_t id, uint32_t risetime, uint32_t falltime)
+{
+  printf(" %s id: %d risetime: %d falltime: %d\n",__FUNCTION__, id, risetime, falltime);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_stagePattern(ledId_t id, const ledPatternStep_t *steps, uint32_t n)
+{
+  printf(" %s id: %d steps: %p n: %d\n",__FUNCTION__, id, (const void *)steps, n);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_stageColorSequence(ledId_t id, const ledColorStep_t *steps, uint32_t n)
+{
+  printf(" %s id: %d steps: %p n: %d\n",__FUNCTION__, id, (const void *)steps, n);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_stageOnOff(ledId_t id, const char* onoff)
+{
+  printf(" %s id: %d onoff: %s\n",__FUNCTION__, id, onoff);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_commitUpdate(ledId_t id, int apply)
+{
+  printf(" %s id: %d apply: %d\n",__FUNCTION__, id, apply);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_abortUpdate(ledId_t id)
+{
+  printf(" %s id: %d\n",__FUNCTION__, id);
+  return LED_ERR_NONE;
+}
+
+ledError_t led_getStats(ledStats_t *stats)
+{
+  printf(" %s \n",__FUNCTION__);
+  if (stats)
+    memset(stats, 0, sizeof(ledStats_t));
+  return LED_ERR_NONE;
+}
+
+ledError_t led_getLatency(ledLatencyId_t which, ledLatency_t *latency)
+{
+  printf(" %s which: %d\n",__FUNCTION__, which);
+  if (latency)
+    memset(latency, 0, sizeof(ledLatency_t));
+  return LED_ERR_NONE;
+}
+
+const char* led_getLatencyName(ledLatencyId_t which)
+{
+  printf(" %s which: %d\n",__FUNCTION__, which);
+  return "unknown";
+}
 
 const char* led_getErrorMsg(ledError_t err)
 {
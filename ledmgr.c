@@ -25,6 +25,11 @@
 #include <string.h> 
 #include <pthread.h>
 #include <unistd.h>
+#include <errno.h>
+#include <ctype.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include <sys/inotify.h>
 
 #include "ledmgrlogger.h"
 #include "ledmgr.h"
@@ -45,6 +50,10 @@ extern "C"{
 #define LEDMGR_ASSERT_NOT_NULL(P)       if ((P) == NULL) return LED_MGR_ERR_GENERAL
 #define DEF_USER_ADMIN_NAME              "administrator"
 #define XW_INIT_MAX_RETRY                 25
+#define XW_SYSTEM_CONF                    "/opt/usr_config/xwsystem.conf"
+#define LED_GROUP_STAGE_TIMEOUT_MS        1000
+#define LED_WATCH_RETRY_SEC               5
+#define XW_SEQUENCE_RETRY_SEC             60
 
 /* Telemetry 2.0 */
 #include "telemetry_busmessage_sender.h"
@@ -87,6 +96,11 @@ ledRGBColor g_xwledColorVal[LED_MGR_COLOR_MAX] = {
   {LED_MGR_COLOR_BLUE, 0, 0, 0, 0, 255, 150},
 };
 
+/* A calibration reload rewrites the color tables, readers copy a color out under ledcolormutex */
+static pthread_mutex_t ledcolormutex = PTHREAD_MUTEX_INITIALIZER;
+/* Count of the color table changes */
+static uint32_t g_ledColorGen = 0;
+
 typedef struct ledOp{
   ledMgrOp_t op;      /* operation */
   int32_t ontime;    /* on time in ms */
@@ -101,50 +115,132 @@ ledOp g_ledOpVal[LED_MGR_OP_MAX] = {
   {LED_MGR_OP_SLOW_BLINK, 200, 400, INVALID_TIME},
   {LED_MGR_OP_DOUBLE_BLINK, 200, 100, 1000},
   {LED_MGR_OP_FAST_BLINK, 100, 100, INVALID_TIME},
-  {LED_MGR_OP_NO_LIGHT, INVALID_TIME, INVALID_TIME, INVALID_TIME}   
+  {LED_MGR_OP_NO_LIGHT, INVALID_TIME, INVALID_TIME, INVALID_TIME},
+  {LED_MGR_OP_FADE_IN, 1000, INVALID_TIME, INVALID_TIME},
+  {LED_MGR_OP_FADE_OUT, INVALID_TIME, 1000, INVALID_TIME},
+  {LED_MGR_OP_BREATHE, 1500, 1500, INVALID_TIME}
 };
 
 /* Static functions */
 static const ledOp* getOpVal(ledMgrOp_t op);
-static const ledRGBColor* getColorVal(ledMgrColor_t color);
-static const ledRGBColor* getxwColorVal(ledMgrColor_t color);
+static const ledRGBColor* getColorVal(ledMgrColor_t color, ledRGBColor *rgb);
+static const ledRGBColor* getxwColorVal(ledMgrColor_t color, ledRGBColor *rgb);
 static ledMgrErr_t led_xw_init(int retry);
 static ledMgrErr_t led_xw_setOp(ledId_t id, ledMgrOp_t op, ledMgrColor_t color);
+static ledMgrErr_t ledmgr_applyState(ledMgrState_t state, bool reload);
+static void ledmgr_startWatch(void);
+static int ledmgr_openWatch(void);
 
-static pthread_mutex_t ledinitmutex = PTHREAD_MUTEX_INITIALIZER;
+/* Kinds of led commands */
+typedef enum _ledCmdType_t{
+  LED_CMD_OP = 0,                 /* ledmgr_setOp */
+  LED_CMD_IR_BRIGHTNESS,          /* ledmgr_setIrBrightness */
+  LED_CMD_SEQUENCE                /* ledmgr_setColorSequence */
+}ledCmdType_t;
 
-/* Function to get default RGB color values */
-static const ledRGBColor* getColorVal(ledMgrColor_t color)
-{
-  int i;
-  
-  for(i = 0; i < LED_MGR_COLOR_MAX; i++){
-    if(g_ledColorVal[i].color == color)
-      break;    
-  }
-  
-  if(LED_MGR_COLOR_MAX != i)
-    return &g_ledColorVal[i];
-  else
-    return NULL;
-}
+/* Commands of the leds set by one ledmgr_setState, every led applies its command once all have staged theirs */
+typedef struct ledCmdGroup{
+  ledMgrState_t state;
+  uint32_t staging;               /* leds still staging their command */
+  uint32_t running;               /* leds still running their command */
+  bool staged[LED_ID_MAX];        /* led has staged or dropped its command */
+  uint64_t start;                 /* time the state was set, monotonic us */
+  pthread_cond_t cond;            /* signalled when a led has staged */
+}ledCmdGroup;
 
-/* Function to get default xw RGB color values */
-static const ledRGBColor* getxwColorVal(ledMgrColor_t color)
+/* Led command, run by the owner thread of the led */
+typedef struct ledCmd{
+  ledCmdType_t type;
+  ledMgrOp_t op;                  /* LED_CMD_OP */
+  ledMgrColor_t color;            /* LED_CMD_OP */
+  uint8_t brightness;             /* LED_CMD_IR_BRIGHTNESS */
+  uint32_t ramptime;              /* LED_CMD_IR_BRIGHTNESS */
+  ledMgrColor_t colors[LED_MGR_SEQUENCE_MAX_COLORS]; /* LED_CMD_SEQUENCE */
+  uint32_t count;                 /* LED_CMD_SEQUENCE, number of colors */
+  uint32_t steptime;              /* LED_CMD_SEQUENCE, time of every color in ms */
+  ledCmdGroup *group;             /* leds applied together, NULL if none */
+}ledCmd;
+
+/* Pending command of a led, a newer command replaces one not yet taken by the owner thread */
+typedef struct ledCmdSlot{
+  ledCmd cmd;                     /* latest command */
+  uint32_t queued;                /* commands queued so far */
+  uint32_t taken;                 /* commands taken by the owner thread or superseded so far */
+  uint32_t done;                  /* commands taken effect or superseded so far */
+  bool owned;                     /* owner thread is running */
+  pthread_cond_t cond;            /* signalled when a command is queued */
+}ledCmdSlot;
+
+static pthread_mutex_t ledcmdmutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ledcmddonecond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t ledcmdonce = PTHREAD_ONCE_INIT;
+static ledCmdSlot g_ledCmdSlot[LED_ID_MAX];
+
+/* Keyframe of a color sequence */
+typedef struct ledKeyframe{
+  ledMgrColor_t color;
+  uint32_t duration;              /* time the color is shown in ms */
+}ledKeyframe;
+
+/* Color sequence of a led stepped by the sequencer thread */
+typedef struct ledSeq{
+  ledKeyframe keyframe[LED_MGR_SEQUENCE_MAX_COLORS];
+  uint32_t count;                 /* number of keyframes */
+  uint32_t index;                 /* next keyframe */
+  uint64_t due;                   /* time the next keyframe is due, monotonic us */
+  bool active;                    /* sequence is stepped */
+  pthread_mutex_t applymutex;     /* held while a keyframe is applied */
+  ledMgrSequenceStats_t stats;
+}ledSeq;
+
+static pthread_mutex_t ledseqmutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t ledseqonce = PTHREAD_ONCE_INIT;
+static int ledseqfd = -1;
+static ledSeq g_ledSeq[LED_ID_MAX];
+
+static ledMgrState_t g_ledState = LED_MGR_STATE_UNKNOWN;  /* last state set */
+/* held while a state is queued, a reapply can not queue an older state after a newer one */
+static pthread_mutex_t ledstatemutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t ledwatchonce = PTHREAD_ONCE_INIT;
+
+static uint64_t ledmgr_now(void);
+static ledMgrErr_t led_xw_runOp(ledId_t id, ledMgrOp_t op, ledMgrColor_t color, ledCmdGroup *group);
+static ledCmd* ledmgr_opCmd(ledCmd *cmd, ledMgrOp_t op, ledMgrColor_t color);
+static ledCmd* ledmgr_sequenceCmd(ledCmd *cmd, const ledMgrColor_t *colors, uint32_t count, uint32_t steptime);
+static void ledmgr_queueState(ledMgrState_t state, ledCmd *camera, ledCmd *xw);
+
+/* Copy a color out of a color table, NULL if the table has no such color */
+static const ledRGBColor* ledmgr_copyColor(const ledRGBColor *colors, ledMgrColor_t color, ledRGBColor *rgb)
 {
   int i;
 
+  pthread_mutex_lock(&ledcolormutex);
   for(i = 0; i < LED_MGR_COLOR_MAX; i++){
-    if(g_xwledColorVal[i].color == color)
+    if(colors[i].color == color)
       break;
   }
+  if(LED_MGR_COLOR_MAX != i)
+    *rgb = colors[i];
+  pthread_mutex_unlock(&ledcolormutex);
 
   if(LED_MGR_COLOR_MAX != i)
-    return &g_xwledColorVal[i];
+    return rgb;
   else
     return NULL;
 }
 
+/* Function to get default RGB color values */
+static const ledRGBColor* getColorVal(ledMgrColor_t color, ledRGBColor *rgb)
+{
+  return ledmgr_copyColor(g_ledColorVal, color, rgb);
+}
+
+/* Function to get default xw RGB color values */
+static const ledRGBColor* getxwColorVal(ledMgrColor_t color, ledRGBColor *rgb)
+{
+  return ledmgr_copyColor(g_xwledColorVal, color, rgb);
+}
+
 
 /* Function to get default values based on operation */
 static const ledOp* getOpVal(ledMgrOp_t op)
@@ -162,6 +258,121 @@ static const ledOp* getOpVal(ledMgrOp_t op)
     return NULL;
 }
 
+/* Store a new color table, unless it equals the table in use */
+static void ledmgr_storeColors(ledRGBColor *table, const ledRGBColor *colors)
+{
+  pthread_mutex_lock(&ledcolormutex);
+  if(memcmp(table, colors, LED_MGR_COLOR_MAX * sizeof(ledRGBColor)) != 0){
+    memcpy(table, colors, LED_MGR_COLOR_MAX * sizeof(ledRGBColor));
+    __atomic_add_fetch(&g_ledColorGen, 1, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&ledcolormutex);
+}
+
+/* Parse a led color value like 39:255,10:204,0:0, current:pwm of red, green and blue */
+static ledMgrErr_t ledmgr_parseColor(const char *value, ledRGBColor *rgb)
+{
+  uint8_t field[6];
+  const char *p = value;
+  char *end = NULL;
+  long val = 0;
+  int i = 0;
+
+  for(i = 0; i < 6; i++)
+  {
+    errno = 0;
+    val = strtol(p, &end, 10);
+    if(end == p || errno != 0 || val < 0 || val > 255){
+      LEDMGR_LOG_ERROR("Invalid led color value %s", value);
+      return LED_MGR_ERR_INVALID_PARAM;
+    }
+    field[i] = (uint8_t)val;
+    if(i == 5)
+      break;
+    /* current and pwm separated by ':', channels by ',' */
+    if(*end != ((i % 2) ? ',' : ':')){
+      LEDMGR_LOG_ERROR("Invalid led color value %s", value);
+      return LED_MGR_ERR_INVALID_PARAM;
+    }
+    p = end + 1;
+  }
+  while(isspace((unsigned char)*end))
+    end++;
+  if(*end != '\0'){
+    LEDMGR_LOG_ERROR("Invalid led color value %s", value);
+    return LED_MGR_ERR_INVALID_PARAM;
+  }
+
+  rgb->cR = field[0];
+  rgb->bR = field[1];
+  rgb->cG = field[2];
+  rgb->bG = field[3];
+  rgb->cB = field[4];
+  rgb->bB = field[5];
+  LEDMGR_LOG_DEBUG("%d, %d, %d, %d, %d, %d", rgb->cR, rgb->bR, rgb->cG, rgb->bG, rgb->cB, rgb->bB);
+
+  return LED_MGR_ERR_NONE;
+}
+
+/* Read led_color1..led_color5 of xw system.conf in one pass, kept only if all are valid */
+static ledMgrErr_t led_xw_readConf(const char *path)
+{
+  ledRGBColor colors[LED_MGR_COLOR_MAX];
+  bool found[LED_MGR_COLOR_MAX] = {false};
+  char line[256];
+  char *key = NULL;
+  char *value = NULL;
+  long number = 0;
+  int index = 0;
+  FILE *fp = NULL;
+
+  fp = fopen(path, "r");
+  if(fp == NULL)
+    return LED_MGR_ERR_GENERAL;
+
+  while(fgets(line, sizeof(line), fp) != NULL)
+  {
+    key = line;
+    while(isspace((unsigned char)*key))
+      key++;
+    if(strncmp(key, "led_color", 9) != 0 || !isdigit((unsigned char)key[9]))
+      continue;
+    /* led_color<n> then = with optional blanks around it */
+    number = strtol(key + 9, &value, 10);
+    while(*value == ' ' || *value == '\t')
+      value++;
+    if(*value != '=')
+      continue;
+    value++;
+    value[strcspn(value, "\r\n")] = '\0';
+    if(number < 1 || number > LED_MGR_COLOR_MAX){
+      LEDMGR_LOG_ERROR("Skipping unknown color in %s: %s", path, key);
+      continue;
+    }
+    index = (int)number - 1;
+
+    LEDMGR_LOG_INFO("led_color from xw system.conf color %d, value %s\n", index, value);
+    if(ledmgr_parseColor(value, &colors[index]) != LED_MGR_ERR_NONE){
+      LEDMGR_LOG_ERROR("Skipping malformed color in %s: %s", path, key);
+      continue;
+    }
+    colors[index].color = (ledMgrColor_t)index;
+    found[index] = true;
+  }
+  fclose(fp);
+
+  for(index = 0; index < LED_MGR_COLOR_MAX; index++)
+  {
+    if(!found[index]){
+      LEDMGR_LOG_ERROR("led_color%d not found in %s", index + 1, path);
+      return LED_MGR_ERR_GENERAL;
+    }
+  }
+  ledmgr_storeColors(g_xwledColorVal, colors);
+
+  return LED_MGR_ERR_NONE;
+}
+
 /* API to initialize xw ledmgr */
 ledMgrErr_t led_xw_init(int retry)
 {
@@ -175,7 +386,7 @@ ledMgrErr_t led_xw_init(int retry)
   while (count <= retry)
   {
     /* To avoid reading xw system.conf on every boot, we store it locally */
-    if (access("/opt/usr_config/xwsystem.conf", F_OK) != 0)
+    if (access(XW_SYSTEM_CONF, F_OK) != 0)
     {
 
       int retval=0;
@@ -191,69 +402,11 @@ ledMgrErr_t led_xw_init(int retry)
     }
     else
     {
-      LEDMGR_LOG_INFO("Creating xw_led_conf");
-      exec_sys_command("grep -r led_color1 /opt/usr_config/xwsystem.conf | cut -d = -f2 > /tmp/xw_led_conf", NULL);
-      exec_sys_command("grep -r led_color2 /opt/usr_config/xwsystem.conf | cut -d = -f2 >> /tmp/xw_led_conf", NULL);
-      exec_sys_command("grep -r led_color3 /opt/usr_config/xwsystem.conf | cut -d = -f2 >> /tmp/xw_led_conf", NULL);
-      exec_sys_command("grep -r led_color4 /opt/usr_config/xwsystem.conf | cut -d = -f2 >> /tmp/xw_led_conf", NULL);
-      exec_sys_command("grep -r led_color5 /opt/usr_config/xwsystem.conf | cut -d = -f2 >> /tmp/xw_led_conf", NULL);
       break;
     }
   }
-  
-  FILE * fp;
-  int index = 0;
-  char content[50];
-  fp = fopen ("/tmp/xw_led_conf", "r");
-  if (fp != NULL)
-  {
-    while(index < LED_MGR_COLOR_MAX)
-    {
-      g_xwledColorVal[index].color = (ledMgrColor_t)index;
-      fgets(content, 50, fp);
-
-      //current R
-      LEDMGR_LOG_INFO("led_color from system.conf color %d, value %s\n", index, content);
-      char *col = strtok(content, ":");
-      LEDMGR_ASSERT_NOT_NULL(col);
-      g_xwledColorVal[index].cR = (uint8_t)atoi(col);
-      LEDMGR_LOG_DEBUG("%d, ", g_xwledColorVal[index].cR);
-
-      //pwm R
-      col = strtok(NULL, ",");
-      LEDMGR_ASSERT_NOT_NULL(col);
-      g_xwledColorVal[index].bR = (uint8_t)atoi(col);
-      LEDMGR_LOG_DEBUG("%d, ", g_xwledColorVal[index].bR);
-
-      //current G
-      col = strtok(NULL, ":");
-      LEDMGR_ASSERT_NOT_NULL(col);
-      g_xwledColorVal[index].cG = (uint8_t)atoi(col);
-      LEDMGR_LOG_DEBUG("%d, ", g_xwledColorVal[index].cG);
-
-      //pwm G
-      col = strtok(NULL, ",");
-      LEDMGR_ASSERT_NOT_NULL(col);
-      g_xwledColorVal[index].bG = (uint8_t)atoi(col);
-      LEDMGR_LOG_DEBUG("%d, ", g_xwledColorVal[index].bG);
-
-      //current B
-      col = strtok(NULL, ":");
-      LEDMGR_ASSERT_NOT_NULL(col);
-      g_xwledColorVal[index].cB = (uint8_t)atoi(col);
-      LEDMGR_LOG_DEBUG("%d, ", g_xwledColorVal[index].cB);
-
-      //pwm B
-      col = strtok(NULL, ",");
-      LEDMGR_ASSERT_NOT_NULL(col);
-      g_xwledColorVal[index].bB = (uint8_t)atoi(col);
-      LEDMGR_LOG_DEBUG("%d", g_xwledColorVal[index].bB);
-
-      index++;
-    }
-    fclose(fp);
-  }
-  else
+
+  if (led_xw_readConf(XW_SYSTEM_CONF) != LED_MGR_ERR_NONE)
   {
     /* use default values */
     LEDMGR_LOG_ERROR("Unable to read led color values from xw system.conf.");
@@ -264,88 +417,79 @@ ledMgrErr_t led_xw_init(int retry)
   return LED_MGR_ERR_NONE;
 }
 
+/* Read the led color values of system.conf, kept only if all are valid */
+static ledMgrErr_t ledmgr_readConf(void)
+{
+  SYS_INFO systeminfo;
+  ledRGBColor colors[LED_MGR_COLOR_MAX];
+  int index = 0;
+
+  /* Populate led current and pwm values from system.conf  */
+  if(SYSINFO_ReadConfigData(&systeminfo) != SYSTEM_OK)
+  {
+    /* use default values */
+    LEDMGR_LOG_ERROR("Unable to read led color values from system.conf.");
+    return LED_MGR_ERR_GENERAL;
+  }
+
+  /* systeminfo.led_color_val[0..5] contains current and pwm values of
+   * AMBER, WHITE, RED, GREEN and BLUE respectively
+   * Example string. led_color1=39:255,10:204,0:0 */
+  for(index = 0; index < LED_MGR_COLOR_MAX; index++)
+  {
+    LEDMGR_LOG_INFO("led_color from system.conf color %d, value %s\n", index, systeminfo.led_color_val[index]);
+    if(ledmgr_parseColor(systeminfo.led_color_val[index], &colors[index]) != LED_MGR_ERR_NONE)
+    {
+      LEDMGR_LOG_ERROR("Invalid led color values in system.conf.");
+      return LED_MGR_ERR_GENERAL;
+    }
+    colors[index].color = (ledMgrColor_t)index;
+  }
+  ledmgr_storeColors(g_ledColorVal, colors);
+
+  return LED_MGR_ERR_NONE;
+}
+
 /* API to initialize ledmgr */
 ledMgrErr_t ledmgr_init(void)
 {  
   int ret = 0; 
   int led_mode = 0; 
+  ledMgrErr_t err = LED_MGR_ERR_NONE;
+
   ret = PRO_SetInt(SEC_SYS, SYS_LED_MODE, led_mode, SYSTEM_CONF); // success return 0, others return value mean something error 
   if (ret != LED_ERR_NONE)
     LEDMGR_LOG_INFO("Error setting led more");
 
-  SYS_INFO systeminfo;
-  int status = 0;
-  int index = 0;
-  
-  /* Populate led current and pwm values from system.conf  */
-  status = SYSINFO_ReadConfigData(&systeminfo);
-  
-  /* systeminfo.led_color_val[0..5] contains current and pwm values of
-   * AMBER, WHITE, RED, GREEN and BLUE respectively */ 
-
-   if(status == SYSTEM_OK)
-   {
-    /* parse current and pwm values from systeminfo 
-     * Example string. led_color1=39:255,10:204,0:0 */
-    
-    while(index < LED_MGR_COLOR_MAX)
-    {
-      g_ledColorVal[index].color = (ledMgrColor_t)index;
-      
-      //current R
-      LEDMGR_LOG_INFO("led_color from system.conf color %d, value %s\n", index, systeminfo.led_color_val[index]);
-      char *col = strtok(systeminfo.led_color_val[index], ":");
-      LEDMGR_ASSERT_NOT_NULL(col);
-      g_ledColorVal[index].cR = (uint8_t)atoi(col);
-      LEDMGR_LOG_DEBUG("%d, ", g_ledColorVal[index].cR);
-
-      //pwm R
-      col = strtok(NULL, ",");
-      LEDMGR_ASSERT_NOT_NULL(col);
-      g_ledColorVal[index].bR = (uint8_t)atoi(col);
-      LEDMGR_LOG_DEBUG("%d, ", g_ledColorVal[index].bR);
-
-      //current G
-      col = strtok(NULL, ":");
-      LEDMGR_ASSERT_NOT_NULL(col);
-      g_ledColorVal[index].cG = (uint8_t)atoi(col);
-      LEDMGR_LOG_DEBUG("%d, ", g_ledColorVal[index].cG);
-
-      //pwm G
-      col = strtok(NULL, ",");
-      LEDMGR_ASSERT_NOT_NULL(col);
-      g_ledColorVal[index].bG = (uint8_t)atoi(col);
-      LEDMGR_LOG_DEBUG("%d, ", g_ledColorVal[index].bG);
-
-      //current B
-      col = strtok(NULL, ":");
-      LEDMGR_ASSERT_NOT_NULL(col);
-      g_ledColorVal[index].cB = (uint8_t)atoi(col);
-      LEDMGR_LOG_DEBUG("%d, ", g_ledColorVal[index].cB);
-
-      //pwm B
-      col = strtok(NULL, ",");
-      LEDMGR_ASSERT_NOT_NULL(col);
-      g_ledColorVal[index].bB = (uint8_t)atoi(col);
-      LEDMGR_LOG_DEBUG("%d", g_ledColorVal[index].bB);
-
-      index++;
-    }
-    led_xw_init(XW_INIT_MAX_RETRY);
-   }
-   else
-   {
-    /* use default values */
-    LEDMGR_LOG_ERROR("Unable to read led color values from system.conf.");
-    led_xw_init(XW_INIT_MAX_RETRY);
-    return LED_MGR_ERR_GENERAL;
-   }   
-   return LED_MGR_ERR_NONE;
+  err = ledmgr_readConf();
+  led_xw_init(XW_INIT_MAX_RETRY);
+  /* pick up recalibrations from now on */
+  pthread_once(&ledwatchonce, ledmgr_startWatch);
+
+  return err;
 }
 
 /* API to set led state */
 ledMgrErr_t ledmgr_setState(ledMgrState_t state)
 {
+  ledMgrErr_t err = LED_MGR_ERR_NONE;
+
+  pthread_mutex_lock(&ledstatemutex);
+  err = ledmgr_applyState(state, false);
+  /* applied again when the calibration changes */
+  if (err == LED_MGR_ERR_NONE)
+    g_ledState = state;
+  pthread_mutex_unlock(&ledstatemutex);
+
+  return err;
+}
+
+/* Queue the led operations of a state, without telemetry when reapplied for a new calibration */
+static ledMgrErr_t ledmgr_applyState(ledMgrState_t state, bool reload)
+{
+  ledCmd camera;
+  ledCmd xw;
+
   switch(state)
   {
     case LED_MGR_STATE_BOOT_UP:
@@ -357,53 +501,45 @@ ledMgrErr_t ledmgr_setState(ledMgrState_t state)
       break;
     case LED_MGR_STATE_INCORRECT_XW:
       /* incompatible xw */
-      LEDMGR_LOG_INFO("Led State = LED_MGR_STATE_INCORRECT_XW");
-      while (true)
       {
-        ledmgr_setOp(LED_ID_CAMERA_FRONT_PANEL, LED_MGR_OP_SOLID_LIGHT, LED_MGR_COLOR_AMBER);
-        led_xw_setOp(LED_ID_XW_FRONT_PANEL, LED_MGR_OP_SOLID_LIGHT, LED_MGR_COLOR_AMBER);
-        sleep (1);
-        ledmgr_setOp(LED_ID_CAMERA_FRONT_PANEL, LED_MGR_OP_SOLID_LIGHT, LED_MGR_COLOR_RED);
-        led_xw_setOp(LED_ID_XW_FRONT_PANEL, LED_MGR_OP_SOLID_LIGHT, LED_MGR_COLOR_RED);
-        sleep (1);
+        /* alternate amber and red every second, run by the leds where they can */
+        const ledMgrColor_t colors[2] = {LED_MGR_COLOR_AMBER, LED_MGR_COLOR_RED};
+        ledmgr_queueState(state, ledmgr_sequenceCmd(&camera, colors, 2, 1000), ledmgr_sequenceCmd(&xw, colors, 2, 1000));
       }
+      LEDMGR_LOG_INFO("Led State = LED_MGR_STATE_INCORRECT_XW");
       break;
     case LED_MGR_STATE_READY_TO_PAIR:
       /* ready to pair state */
-      ledmgr_setOp(LED_ID_CAMERA_FRONT_PANEL, LED_MGR_OP_BLINK, LED_MGR_COLOR_WHITE);
-      led_xw_setOp(LED_ID_XW_FRONT_PANEL, LED_MGR_OP_BLINK, LED_MGR_COLOR_WHITE);
+      ledmgr_queueState(state, ledmgr_opCmd(&camera, LED_MGR_OP_BLINK, LED_MGR_COLOR_WHITE), ledmgr_opCmd(&xw, LED_MGR_OP_BLINK, LED_MGR_COLOR_WHITE));
       LEDMGR_LOG_INFO("Led State = LED_MGR_STATE_READY_TO_PAIR");
       break;
     case LED_MGR_STATE_TROUBLE_CONNECTING:
       /* trouble connecting state */
-      ledmgr_setOp(LED_ID_CAMERA_FRONT_PANEL, LED_MGR_OP_BLINK, LED_MGR_COLOR_AMBER);
-      led_xw_setOp(LED_ID_XW_FRONT_PANEL, LED_MGR_OP_BLINK, LED_MGR_COLOR_AMBER);
+      ledmgr_queueState(state, ledmgr_opCmd(&camera, LED_MGR_OP_BLINK, LED_MGR_COLOR_AMBER), ledmgr_opCmd(&xw, LED_MGR_OP_BLINK, LED_MGR_COLOR_AMBER));
       LEDMGR_LOG_INFO("Led State = LED_MGR_STATE_TROUBLE_CONNECTING");
-      t2_event_d("LED_INFO_CONNBad", 1);
+      if (!reload)
+        t2_event_d("LED_INFO_CONNBad", 1);
       break;
     case LED_MGR_STATE_NOT_PROVISIONED:
       /* camera not provisioned */
-      ledmgr_setOp(LED_ID_CAMERA_FRONT_PANEL, LED_MGR_OP_BLINK, LED_MGR_COLOR_AMBER);
-      led_xw_setOp(LED_ID_XW_FRONT_PANEL, LED_MGR_OP_BLINK, LED_MGR_COLOR_AMBER);
+      ledmgr_queueState(state, ledmgr_opCmd(&camera, LED_MGR_OP_BLINK, LED_MGR_COLOR_AMBER), ledmgr_opCmd(&xw, LED_MGR_OP_BLINK, LED_MGR_COLOR_AMBER));
       LEDMGR_LOG_INFO("Led State = LED_MGR_STATE_NOT_PROVISIONED");
       break;
     case LED_MGR_STATE_WORKING_NORMALLY:
       /* working normally */
-      ledmgr_setOp(LED_ID_CAMERA_FRONT_PANEL, LED_MGR_OP_SOLID_LIGHT, LED_MGR_COLOR_BLUE);
-      led_xw_setOp(LED_ID_XW_FRONT_PANEL, LED_MGR_OP_SOLID_LIGHT, LED_MGR_COLOR_BLUE);
+      ledmgr_queueState(state, ledmgr_opCmd(&camera, LED_MGR_OP_SOLID_LIGHT, LED_MGR_COLOR_BLUE), ledmgr_opCmd(&xw, LED_MGR_OP_SOLID_LIGHT, LED_MGR_COLOR_BLUE));
       LEDMGR_LOG_INFO("Led State = LED_MGR_STATE_WORKING_NORMALLY");
-      t2_event_d("LED_INFO_CONNGood", 1);
+      if (!reload)
+        t2_event_d("LED_INFO_CONNGood", 1);
       break;
     case LED_MGR_STATE_2_WAY_VOICE:
       /* two way voice state */
-      ledmgr_setOp(LED_ID_CAMERA_FRONT_PANEL, LED_MGR_OP_BLINK, LED_MGR_COLOR_BLUE);
-      led_xw_setOp(LED_ID_XW_FRONT_PANEL, LED_MGR_OP_BLINK, LED_MGR_COLOR_BLUE);
+      ledmgr_queueState(state, ledmgr_opCmd(&camera, LED_MGR_OP_BLINK, LED_MGR_COLOR_BLUE), ledmgr_opCmd(&xw, LED_MGR_OP_BLINK, LED_MGR_COLOR_BLUE));
       LEDMGR_LOG_INFO("Led State = LED_MGR_STATE_2_WAY_VOICE");
       break;
     case LED_MGR_STATE_FACTORY_DOWNLOAD_MODE:
       /* factory download mode state */
-      ledmgr_setOp(LED_ID_CAMERA_FRONT_PANEL, LED_MGR_OP_BLINK, LED_MGR_COLOR_GREEN);
-      led_xw_setOp(LED_ID_XW_FRONT_PANEL, LED_MGR_OP_BLINK, LED_MGR_COLOR_GREEN);
+      ledmgr_queueState(state, ledmgr_opCmd(&camera, LED_MGR_OP_BLINK, LED_MGR_COLOR_GREEN), ledmgr_opCmd(&xw, LED_MGR_OP_BLINK, LED_MGR_COLOR_GREEN));
       LEDMGR_LOG_INFO("Led State = LED_MGR_STATE_FACTORY_DOWNLOAD_MODE");
       break;
     case LED_MGR_STATE_UNKNOWN:
@@ -417,66 +553,274 @@ ledMgrErr_t ledmgr_setState(ledMgrState_t state)
   return LED_MGR_ERR_NONE;
 }
 
-/* API to set led operation and color */
-ledMgrErr_t ledmgr_setOp(ledId_t id, ledMgrOp_t op, ledMgrColor_t color)
+/* Watch system.conf and xw system.conf, reload the led colors when they change and reapply the state */
+static void* ledmgr_watchThread(void *arg)
 {
+  int fd = -1;
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  const struct inotify_event *event = NULL;
+  const char *conf = strrchr(SYSTEM_CONF, '/');
+  const char *xwconf = strrchr(XW_SYSTEM_CONF, '/');
+  uint32_t gen = 0;
+  ledMgrState_t state = LED_MGR_STATE_UNKNOWN;
+  bool reload = false;
+  bool xwreload = false;
+  bool rewatch = false;
+  bool watched = false;
+  bool failed = false;
+  ssize_t len = 0;
+  char *p = NULL;
+
+  (void)arg;
+  conf = conf ? conf + 1 : SYSTEM_CONF;
+  xwconf = xwconf ? xwconf + 1 : XW_SYSTEM_CONF;
+  while (true)
+  {
+    /* a burst of events of a file is one reload */
+    reload = false;
+    xwreload = false;
+    rewatch = false;
+    if (fd < 0) {
+      fd = ledmgr_openWatch();
+      if (fd < 0) {
+        if (!failed)
+          LEDMGR_LOG_ERROR("Unable to watch led colors, errno %d, retry every %d s", errno, LED_WATCH_RETRY_SEC);
+        failed = true;
+        sleep(LED_WATCH_RETRY_SEC);
+        continue;
+      }
+      failed = false;
+      /* the files may have changed while they were not watched */
+      reload = watched;
+      xwreload = watched;
+      watched = true;
+    }
+    else {
+      len = read(fd, buf, sizeof(buf));
+      if (len < 0 && errno == EINTR)
+        continue;
+      if (len <= 0) {
+        LEDMGR_LOG_ERROR("Led color watch read failed, errno %d, watch again", errno);
+        sleep(LED_WATCH_RETRY_SEC);
+        rewatch = true;
+      }
+      for (p = buf; len > 0 && p < buf + len; p += sizeof(struct inotify_event) + event->len)
+      {
+        event = (const struct inotify_event *)p;
+        /* events were dropped, any file may have changed */
+        if (event->mask & IN_Q_OVERFLOW) {
+          reload = true;
+          xwreload = true;
+        }
+        /* the directory was removed or replaced */
+        if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF))
+          rewatch = true;
+        if (event->len == 0)
+          continue;
+        if (strcmp(event->name, conf) == 0)
+          reload = true;
+        if (strcmp(event->name, xwconf) == 0)
+          xwreload = true;
+      }
+      if (rewatch) {
+        /* both files are read again once the new watch is in place */
+        close(fd);
+        fd = -1;
+        continue;
+      }
+    }
+
+    gen = __atomic_load_n(&g_ledColorGen, __ATOMIC_ACQUIRE);
+    if (reload)
+      ledmgr_readConf();
+    if (xwreload)
+      led_xw_readConf(XW_SYSTEM_CONF);
+    /* the files hold other settings too, the leds change only with the colors */
+    if (gen == __atomic_load_n(&g_ledColorGen, __ATOMIC_ACQUIRE))
+      continue;
+
+    pthread_mutex_lock(&ledstatemutex);
+    state = g_ledState;
+    LEDMGR_LOG_INFO("Led colors recalibrated, reapply state %d", state);
+    if (state != LED_MGR_STATE_UNKNOWN)
+      ledmgr_applyState(state, true);
+    pthread_mutex_unlock(&ledstatemutex);
+  }
+
+  return NULL;
+}
+
+/* Add an inotify watch on the directory of a file, files are often replaced rather than written in place */
+static int ledmgr_watchDir(int fd, const char *path)
+{
+  char dir[256];
+  const char *name = strrchr(path, '/');
+
+  if (name == NULL || (size_t)(name - path) >= sizeof(dir)) {
+    errno = EINVAL;
+    return -1;
+  }
+  memcpy(dir, path, name - path);
+  dir[name - path] = '\0';
+  return inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+}
+
+/* Watch the directories of system.conf and xw system.conf, -1 with errno set if either can not be watched */
+static int ledmgr_openWatch(void)
+{
+  int fd = inotify_init1(IN_CLOEXEC);
+  int err = 0;
+
+  if (fd < 0)
+    return -1;
+  if (ledmgr_watchDir(fd, SYSTEM_CONF) < 0 || ledmgr_watchDir(fd, XW_SYSTEM_CONF) < 0) {
+    err = errno;
+    close(fd);
+    errno = err;
+    return -1;
+  }
+
+  return fd;
+}
+
+/* Start watching the led color calibration, once */
+static void ledmgr_startWatch(void)
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&thread, &attr, ledmgr_watchThread, NULL) != 0)
+    LEDMGR_LOG_ERROR("Unable to create led color watch thread");
+  pthread_attr_destroy(&attr);
+}
+
+/* Led has staged its command of a state, wait for the other leds to stage theirs so they apply together */
+static void ledmgr_groupStaged(ledCmdGroup *group, ledId_t id)
+{
+  struct timespec deadline;
+
+  if (group == NULL)
+    return;
+
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  deadline.tv_sec += LED_GROUP_STAGE_TIMEOUT_MS / 1000;
+  deadline.tv_nsec += (LED_GROUP_STAGE_TIMEOUT_MS % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
+  pthread_mutex_lock(&ledcmdmutex);
+  if (!group->staged[id]) {
+    group->staged[id] = true;
+    group->staging--;
+    pthread_cond_broadcast(&group->cond);
+  }
+  while (group->staging > 0)
+  {
+    /* a led slow to stage does not hold the others back for long */
+    if (pthread_cond_timedwait(&group->cond, &ledcmdmutex, &deadline) == ETIMEDOUT) {
+      LEDMGR_LOG_WARN("Led %d applies state %d without waiting for %d other leds", id, group->state, group->staging);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&ledcmdmutex);
+}
+
+/* Led is done with its command of a state or the command was superseded, called with ledcmdmutex held */
+static void ledmgr_groupDone(ledCmdGroup *group, ledId_t id)
+{
+  if (group == NULL)
+    return;
+
+  if (!group->staged[id]) {
+    group->staged[id] = true;
+    group->staging--;
+    pthread_cond_broadcast(&group->cond);
+  }
+  if (--group->running == 0) {
+    LEDMGR_LOG_INFO("Led state %d applied in %llu us", group->state, (unsigned long long)(ledmgr_now() - group->start));
+    pthread_cond_destroy(&group->cond);
+    free(group);
+  }
+}
+
+/* Run a led operation, on the owner thread of the led */
+static ledMgrErr_t ledmgr_runOp(ledId_t id, ledMgrOp_t op, ledMgrColor_t color, ledCmdGroup *group)
+{
+  ledRGBColor rgb;
   const ledRGBColor* pColor;
   const ledOp*     pOp;
   int   err = 0;
+  ledError_t halErr = LED_ERR_NONE;
 
   if (id == LED_ID_XW_FRONT_PANEL) {
-    return led_xw_setOp(id, op, color);
-  }  
+    return led_xw_runOp(id, op, color, group);
+  }
   pOp = (ledOp*) getOpVal(op);
-  pColor = (ledRGBColor*) getColorVal(color);
+  pColor = getColorVal(color, &rgb);
   if(pOp == NULL || pColor == NULL){
     LEDMGR_LOG_ERROR("Unable to get color or operation %d %d", op, color);
     return LED_MGR_ERR_INVALID_PARAM;
   }
 
-  err = pthread_mutex_trylock(&ledinitmutex);
-  if(err != 0){
-    LEDMGR_LOG_ERROR("Unable to acquire mutex err: %s", strerror(err));
-    LEDMGR_LOG_ERROR("Led manager is busy. Try again later...");
-    return LED_MGR_ERR_BUSY;
-  }
-
   /* initialize led hal */
   led_init(id);
+  /* stage the whole operation and publish it as one update */
+  led_beginUpdate(id);
   switch(op)
   {
     case LED_MGR_OP_SOLID_LIGHT:
-      led_reset(id);
-      led_setBrightness(id, pColor->bR, pColor->bG, pColor->bB);
-      led_setColor(id, pColor->cR, pColor->cG, pColor->cB);
-      led_setOnOff(id, "on");
+      led_stageReset(id);
+      led_stageBrightness(id, pColor->bR, pColor->bG, pColor->bB);
+      led_stageColor(id, pColor->cR, pColor->cG, pColor->cB);
+      led_stageOnOff(id, "on");
       break;
     case LED_MGR_OP_BLINK:
-      led_reset(id);
-      led_setBrightness(id, pColor->bR, pColor->bG, pColor->bB);
-      led_setColor(id, pColor->cR, pColor->cG, pColor->cB);
-      led_setBlink(id, pOp->ontime, pOp->offtime);
+      led_stageReset(id);
+      led_stageBrightness(id, pColor->bR, pColor->bG, pColor->bB);
+      led_stageColor(id, pColor->cR, pColor->cG, pColor->cB);
+      led_stageBlink(id, pOp->ontime, pOp->offtime);
       break;
     case LED_MGR_OP_SLOW_BLINK:
-      led_reset(id);
-      led_setBrightness(id, pColor->bR, pColor->bG, pColor->bB);
-      led_setColor(id, pColor->cR, pColor->cG, pColor->cB);
-      led_setBlink(id, pOp->ontime, pOp->offtime);    
+      led_stageReset(id);
+      led_stageBrightness(id, pColor->bR, pColor->bG, pColor->bB);
+      led_stageColor(id, pColor->cR, pColor->cG, pColor->cB);
+      led_stageBlink(id, pOp->ontime, pOp->offtime);    
       break;
     case LED_MGR_OP_DOUBLE_BLINK:
-      led_reset(id);
-      led_setBrightness(id, pColor->bR, pColor->bG, pColor->bB);
-      led_setColor(id, pColor->cR, pColor->cG, pColor->cB);
-      led_setBlinkSequence(id, pOp->ontime, pOp->offtime, 2, pOp->longofftime);
+      led_stageReset(id);
+      led_stageBrightness(id, pColor->bR, pColor->bG, pColor->bB);
+      led_stageColor(id, pColor->cR, pColor->cG, pColor->cB);
+      led_stageBlinkSequence(id, pOp->ontime, pOp->offtime, 2, pOp->longofftime);
       break;
     case LED_MGR_OP_FAST_BLINK:
-      led_reset(id);
-      led_setBrightness(id, pColor->bR, pColor->bG, pColor->bB);
-      led_setColor(id, pColor->cR, pColor->cG, pColor->cB);
-      led_setBlink(id, pOp->ontime, pOp->offtime);
+      led_stageReset(id);
+      led_stageBrightness(id, pColor->bR, pColor->bG, pColor->bB);
+      led_stageColor(id, pColor->cR, pColor->cG, pColor->cB);
+      led_stageBlink(id, pOp->ontime, pOp->offtime);
       break;
     case LED_MGR_OP_NO_LIGHT:
-      led_setOnOff(id, "off");
+      led_stageOnOff(id, "off");
+      break;
+    case LED_MGR_OP_FADE_IN:
+      led_stageReset(id);
+      led_stageBrightness(id, pColor->bR, pColor->bG, pColor->bB);
+      led_stageColor(id, pColor->cR, pColor->cG, pColor->cB);
+      led_stageFade(id, 1, pOp->ontime);
+      break;
+    case LED_MGR_OP_FADE_OUT:
+      led_stageReset(id);
+      led_stageBrightness(id, pColor->bR, pColor->bG, pColor->bB);
+      led_stageColor(id, pColor->cR, pColor->cG, pColor->cB);
+      led_stageFade(id, 0, pOp->offtime);
+      break;
+    case LED_MGR_OP_BREATHE:
+      led_stageReset(id);
+      led_stageBrightness(id, pColor->bR, pColor->bG, pColor->bB);
+      led_stageColor(id, pColor->cR, pColor->cG, pColor->cB);
+      led_stageBreathe(id, pOp->ontime, pOp->offtime);
       break;
     case LED_MGR_OP_MAX:
     default:
@@ -484,21 +828,47 @@ ledMgrErr_t ledmgr_setOp(ledId_t id, ledMgrOp_t op, ledMgrColor_t color)
       err = LED_MGR_ERR_INVALID_PARAM;
       break;  
   }
-  /* apply configuration */
-  if(err == LED_MGR_ERR_NONE)
-    led_applySettings(id);
+  /* commit and apply configuration */
+  if(err == LED_MGR_ERR_NONE) {
+    ledmgr_groupStaged(group, id);
+    halErr = led_commitUpdate(id, 1);
+    if(halErr != LED_ERR_NONE) {
+      LEDMGR_LOG_ERROR("Led update failed: %s", led_getErrorMsg(halErr));
+      err = LED_MGR_ERR_GENERAL;
+    }
+  }
+  else
+    led_abortUpdate(id);
 
-  err = pthread_mutex_unlock(&ledinitmutex);
-  if(err != 0){
-    LEDMGR_LOG_ERROR("Led manager unlock mutex failed with err: %s", strerror(err));
+  return (ledMgrErr_t)err;
+}
+
+/* Set IR led brightness, on the owner thread of the IR led */
+static ledMgrErr_t ledmgr_runIrBrightness(uint8_t brightness, uint32_t ramptime)
+{
+  ledId_t id = LED_ID_CAMERA_IR;
+  int   err = 0;
+  ledError_t halErr = LED_ERR_NONE;
+
+  /* initialize led hal */
+  led_init(id);
+  /* stage brightness and on/off as one update */
+  led_beginUpdate(id);
+  led_stageIrBrightness(id, brightness, ramptime);
+  led_stageOnOff(id, brightness ? "on" : "off");
+  halErr = led_commitUpdate(id, 1);
+  if(halErr != LED_ERR_NONE) {
+    LEDMGR_LOG_ERROR("IR led update failed: %s", led_getErrorMsg(halErr));
+    err = (halErr == LED_ERR_INVALID_PARAM) ? LED_MGR_ERR_INVALID_PARAM : LED_MGR_ERR_GENERAL;
   }
 
   return (ledMgrErr_t)err;
 }
 
-/* API to set led operation and color */
-static ledMgrErr_t led_xw_setOp(ledId_t id, ledMgrOp_t op, ledMgrColor_t color)
+/* Run a xw led operation, on the owner thread of the xw led */
+static ledMgrErr_t led_xw_runOp(ledId_t id, ledMgrOp_t op, ledMgrColor_t color, ledCmdGroup *group)
 {
+  ledRGBColor rgb;
   const ledRGBColor* pColor;
   const ledOp*     pOp;
   int   err = 0;
@@ -506,18 +876,12 @@ static ledMgrErr_t led_xw_setOp(ledId_t id, ledMgrOp_t op, ledMgrColor_t color)
   led_xw_init(1);
 
   pOp = (ledOp*) getOpVal(op);
-  pColor = (ledRGBColor*) getxwColorVal(color);
+  pColor = getxwColorVal(color, &rgb);
   if(pOp == NULL || pColor == NULL){
     LEDMGR_LOG_ERROR("Unable to get color or operation %d %d", op, color);
     return LED_MGR_ERR_INVALID_PARAM;
   }
 
-  err = pthread_mutex_trylock(&ledinitmutex);
-  if(err != 0){
-    LEDMGR_LOG_ERROR("Unable to acquire mutex err: %s", strerror(err));
-    LEDMGR_LOG_ERROR("Led manager is busy. Try again later...");
-    return LED_MGR_ERR_BUSY;
-  }
   /* initialize led hal */
   xw_led_init(id);
   switch(op)
@@ -552,8 +916,23 @@ static ledMgrErr_t led_xw_setOp(ledId_t id, ledMgrOp_t op, ledMgrColor_t color)
       xw_led_setBlink(id, pOp->ontime, pOp->offtime);
       break;
     case LED_MGR_OP_NO_LIGHT:
+    case LED_MGR_OP_FADE_OUT:
+      /* XW has no fades, switch off at once */
       xw_led_setOnOff(id, "off");
       break;
+    case LED_MGR_OP_FADE_IN:
+      /* XW has no fades, switch on at once */
+      xw_led_reset(id);
+      xw_led_setBrightness(id, pColor->bR, pColor->bG, pColor->bB);
+      xw_led_setColor(id, pColor->cR, pColor->cG, pColor->cB);
+      break;
+    case LED_MGR_OP_BREATHE:
+      /* XW has no fades, blink with the rise and fall times */
+      xw_led_reset(id);
+      xw_led_setBrightness(id, pColor->bR, pColor->bG, pColor->bB);
+      xw_led_setColor(id, pColor->cR, pColor->cG, pColor->cB);
+      xw_led_setBlink(id, pOp->ontime, pOp->offtime);
+      break;
     case LED_MGR_OP_MAX:
     default:
       LEDMGR_LOG_ERROR("Invalid operation %d", op);
@@ -561,12 +940,525 @@ static ledMgrErr_t led_xw_setOp(ledId_t id, ledMgrOp_t op, ledMgrColor_t color)
       break;
   }
   /* apply configuration */
-  if(err == LED_MGR_ERR_NONE)
+  if(err == LED_MGR_ERR_NONE) {
+    ledmgr_groupStaged(group, id);
     xw_led_applySettings(id);
-  
-  err = pthread_mutex_unlock(&ledinitmutex);
-  if(err != 0){
-    LEDMGR_LOG_ERROR("Led manager unlock mutex failed with err: %s", strerror(err));
   }
+
   return (ledMgrErr_t)err;
 } 
+
+
+/* Hand a color sequence to the led, on the owner thread of the led.
+ * Returns LED_MGR_ERR_OPERATION_NOT_SUPPORTED if the led can not run it by itself */
+static ledMgrErr_t ledmgr_runSequence(ledId_t id, const ledCmd *cmd)
+{
+  ledRGBColor rgb;
+  const ledRGBColor* pColor;
+  ledColorStep_t steps[LED_MGR_SEQUENCE_MAX_COLORS];
+  uint8_t xwcolors[LED_MGR_SEQUENCE_MAX_COLORS][6];
+  uint32_t durations[LED_MGR_SEQUENCE_MAX_COLORS];
+  ledError_t halErr = LED_ERR_NONE;
+  uint32_t i = 0;
+  int ret = 0;
+  /* the xw replied it can not run color sequences */
+  static bool xw_sequence_rejected = false;
+  /* the xw did not answer, it may be reconnecting or run firmware without color sequences */
+  static uint64_t xw_sequence_retry = 0;
+
+  if (id == LED_ID_XW_FRONT_PANEL) {
+    if (__atomic_load_n(&xw_sequence_rejected, __ATOMIC_RELAXED) ||
+        ledmgr_now() < __atomic_load_n(&xw_sequence_retry, __ATOMIC_RELAXED))
+      return LED_MGR_ERR_OPERATION_NOT_SUPPORTED;
+    led_xw_init(1);
+    for (i = 0; i < cmd->count; i++) {
+      pColor = getxwColorVal(cmd->colors[i], &rgb);
+      LEDMGR_ASSERT_NOT_NULL(pColor);
+      xwcolors[i][0] = pColor->cR; xwcolors[i][1] = pColor->bR;
+      xwcolors[i][2] = pColor->cG; xwcolors[i][3] = pColor->bG;
+      xwcolors[i][4] = pColor->cB; xwcolors[i][5] = pColor->bB;
+      durations[i] = cmd->steptime;
+    }
+    xw_led_init(id);
+    ledmgr_groupStaged(cmd->group, id);
+    ret = xw_led_setColorSequence(id, xwcolors, durations, cmd->count);
+    if (ret == LED_ERR_OPERATION_NOT_SUPPORTED) {
+      __atomic_store_n(&xw_sequence_rejected, true, __ATOMIC_RELAXED);
+      LEDMGR_LOG_INFO("Xw led can not run color sequence, step it from ledmgr");
+      return LED_MGR_ERR_OPERATION_NOT_SUPPORTED;
+    }
+    if (ret != 0) {
+      __atomic_store_n(&xw_sequence_retry, ledmgr_now() + XW_SEQUENCE_RETRY_SEC * 1000000ULL, __ATOMIC_RELAXED);
+      LEDMGR_LOG_INFO("Xw led color sequence failed %d, step it from ledmgr for %d s", ret, XW_SEQUENCE_RETRY_SEC);
+      return LED_MGR_ERR_OPERATION_NOT_SUPPORTED;
+    }
+    return LED_MGR_ERR_NONE;
+  }
+
+  for (i = 0; i < cmd->count; i++) {
+    pColor = getColorVal(cmd->colors[i], &rgb);
+    LEDMGR_ASSERT_NOT_NULL(pColor);
+    steps[i].color[0] = pColor->cR; steps[i].brightness[0] = pColor->bR;
+    steps[i].color[1] = pColor->cG; steps[i].brightness[1] = pColor->bG;
+    steps[i].color[2] = pColor->cB; steps[i].brightness[2] = pColor->bB;
+    steps[i].duration = cmd->steptime;
+  }
+  /* initialize led hal */
+  led_init(id);
+  led_beginUpdate(id);
+  led_stageReset(id);
+  halErr = led_stageColorSequence(id, steps, cmd->count);
+  if (halErr != LED_ERR_NONE) {
+    led_abortUpdate(id);
+    LEDMGR_LOG_ERROR("Led color sequence failed: %s", led_getErrorMsg(halErr));
+    return LED_MGR_ERR_INVALID_PARAM;
+  }
+  ledmgr_groupStaged(cmd->group, id);
+  halErr = led_commitUpdate(id, 1);
+  if (halErr == LED_ERR_OPERATION_NOT_SUPPORTED) {
+    LEDMGR_LOG_INFO("Led %d can not run color sequence, step it from ledmgr", id);
+    return LED_MGR_ERR_OPERATION_NOT_SUPPORTED;
+  }
+  if (halErr != LED_ERR_NONE) {
+    LEDMGR_LOG_ERROR("Led update failed: %s", led_getErrorMsg(halErr));
+    return LED_MGR_ERR_GENERAL;
+  }
+
+  return LED_MGR_ERR_NONE;
+}
+
+/* Monotonic time in us */
+static uint64_t ledmgr_now(void)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/* Arm the sequencer timer for the earliest keyframe due, called with ledseqmutex held */
+static void ledmgr_seqArm(void)
+{
+  struct itimerspec its;
+  uint64_t due = 0;
+  int id = LED_ID_CAMERA_FRONT_PANEL;
+
+  for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++)
+  {
+    if (g_ledSeq[id].active && (due == 0 || g_ledSeq[id].due < due))
+      due = g_ledSeq[id].due;
+  }
+  /* no keyframe due disarms the timer */
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = due / 1000000;
+  its.it_value.tv_nsec = (due % 1000000) * 1000;
+  if (timerfd_settime(ledseqfd, TFD_TIMER_ABSTIME, &its, NULL) != 0)
+    LEDMGR_LOG_ERROR("Unable to arm sequencer timer, errno %d", errno);
+}
+
+/* Sequencer thread, shows the keyframes due of every led sequence */
+static void* ledmgr_sequencerThread(void *arg)
+{
+  ledSeq *seq = NULL;
+  ledMgrColor_t color = LED_MGR_COLOR_MAX;
+  uint64_t expirations = 0;
+  uint64_t now = 0;
+  uint64_t drift = 0;
+  int id = LED_ID_CAMERA_FRONT_PANEL;
+
+  (void)arg;
+  while (true)
+  {
+    if (read(ledseqfd, &expirations, sizeof(expirations)) < 0 && errno != EINTR) {
+      LEDMGR_LOG_ERROR("Sequencer timer read failed, errno %d", errno);
+      sleep(1);
+    }
+
+    for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++)
+    {
+      seq = &g_ledSeq[id];
+      /* a new command of the led waits for the keyframe applied */
+      pthread_mutex_lock(&seq->applymutex);
+      pthread_mutex_lock(&ledseqmutex);
+      now = ledmgr_now();
+      if (!seq->active || seq->due > now) {
+        pthread_mutex_unlock(&ledseqmutex);
+        pthread_mutex_unlock(&seq->applymutex);
+        continue;
+      }
+      color = seq->keyframe[seq->index].color;
+      drift = now - seq->due;
+      seq->stats.keyframes++;
+      seq->stats.total_drift_us += drift;
+      if (drift > seq->stats.max_drift_us)
+        seq->stats.max_drift_us = (uint32_t)drift;
+      /* keyframes due at absolute times, the time of the applies does not add up */
+      if (drift >= (uint64_t)seq->keyframe[seq->index].duration * 1000) {
+        /* missed a whole keyframe, restart the schedule rather than rush through it */
+        LEDMGR_LOG_WARN("Led %d keyframe %d late by %llu us", id, seq->index, (unsigned long long)drift);
+        seq->stats.late++;
+        seq->due = now;
+      }
+      seq->due += (uint64_t)seq->keyframe[seq->index].duration * 1000;
+      seq->index = (seq->index + 1) % seq->count;
+      pthread_mutex_unlock(&ledseqmutex);
+
+      ledmgr_runOp((ledId_t)id, LED_MGR_OP_SOLID_LIGHT, color, NULL);
+      pthread_mutex_unlock(&seq->applymutex);
+    }
+
+    pthread_mutex_lock(&ledseqmutex);
+    ledmgr_seqArm();
+    pthread_mutex_unlock(&ledseqmutex);
+  }
+
+  return NULL;
+}
+
+/* Create the sequencer timer and thread */
+static void ledmgr_startSequencer(void)
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+  int id = LED_ID_CAMERA_FRONT_PANEL;
+
+  for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++)
+    pthread_mutex_init(&g_ledSeq[id].applymutex, NULL);
+
+  ledseqfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+  if (ledseqfd < 0) {
+    LEDMGR_LOG_ERROR("Unable to create sequencer timer, errno %d", errno);
+    return;
+  }
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&thread, &attr, ledmgr_sequencerThread, NULL) != 0) {
+    LEDMGR_LOG_ERROR("Unable to create sequencer thread");
+    close(ledseqfd);
+    ledseqfd = -1;
+  }
+  pthread_attr_destroy(&attr);
+}
+
+/* Stop the sequence of a led, waiting for a keyframe being applied */
+static void ledmgr_seqCancel(ledId_t id)
+{
+  ledSeq *seq = &g_ledSeq[id];
+
+  pthread_once(&ledseqonce, ledmgr_startSequencer);
+  pthread_mutex_lock(&seq->applymutex);
+  pthread_mutex_lock(&ledseqmutex);
+  if (seq->active) {
+    LEDMGR_LOG_INFO("Led %d color sequence cancelled, keyframes %u late %u max drift %u us", id,
+                    seq->stats.keyframes, seq->stats.late, seq->stats.max_drift_us);
+    seq->active = false;
+  }
+  /* the timer is rearmed by the sequencer thread when it fires */
+  pthread_mutex_unlock(&ledseqmutex);
+  pthread_mutex_unlock(&seq->applymutex);
+}
+
+/* Hand a color sequence the led can not run by itself to the sequencer thread */
+static ledMgrErr_t ledmgr_seqStart(ledId_t id, const ledCmd *cmd)
+{
+  ledSeq *seq = &g_ledSeq[id];
+  uint32_t i = 0;
+
+  pthread_once(&ledseqonce, ledmgr_startSequencer);
+  if (ledseqfd < 0) {
+    /* no sequencer, hold the first color */
+    return ledmgr_runOp(id, LED_MGR_OP_SOLID_LIGHT, cmd->colors[0], NULL);
+  }
+
+  pthread_mutex_lock(&ledseqmutex);
+  for (i = 0; i < cmd->count; i++)
+  {
+    seq->keyframe[i].color = cmd->colors[i];
+    seq->keyframe[i].duration = cmd->steptime;
+  }
+  seq->count = cmd->count;
+  seq->index = 0;
+  seq->due = ledmgr_now();
+  memset(&seq->stats, 0, sizeof(seq->stats));
+  seq->active = true;
+  ledmgr_seqArm();
+  pthread_mutex_unlock(&ledseqmutex);
+
+  return LED_MGR_ERR_NONE;
+}
+
+/* API to get the timing of the software color sequences of a led */
+ledMgrErr_t ledmgr_getSequenceStats(ledId_t id, ledMgrSequenceStats_t *stats)
+{
+  if(id < LED_ID_CAMERA_FRONT_PANEL || id >= LED_ID_MAX || stats == NULL){
+    LEDMGR_LOG_ERROR("Invalid led %d or stats", id);
+    return LED_MGR_ERR_INVALID_PARAM;
+  }
+
+  pthread_mutex_lock(&ledseqmutex);
+  *stats = g_ledSeq[id].stats;
+  pthread_mutex_unlock(&ledseqmutex);
+
+  return LED_MGR_ERR_NONE;
+}
+
+/* API to check whether a blink or color sequence of a led is run by this process */
+ledMgrErr_t ledmgr_getRunning(ledId_t id, int *running)
+{
+  ledError_t halErr = LED_ERR_NONE;
+
+  if(id < LED_ID_CAMERA_FRONT_PANEL || id >= LED_ID_MAX || running == NULL){
+    LEDMGR_LOG_ERROR("Invalid led %d or running", id);
+    return LED_MGR_ERR_INVALID_PARAM;
+  }
+
+  pthread_mutex_lock(&ledseqmutex);
+  *running = g_ledSeq[id].active ? 1 : 0;
+  pthread_mutex_unlock(&ledseqmutex);
+  if (*running)
+    return LED_MGR_ERR_NONE;
+
+  halErr = led_getRunning(id, running);
+  if (halErr != LED_ERR_NONE) {
+    LEDMGR_LOG_ERROR("Led %d running check failed: %s", id, led_getErrorMsg(halErr));
+    return LED_MGR_ERR_GENERAL;
+  }
+
+  return LED_MGR_ERR_NONE;
+}
+
+/* Run a led command, on the owner thread of the led */
+static ledMgrErr_t ledmgr_runCmd(ledId_t id, const ledCmd *cmd)
+{
+  ledMgrErr_t err = LED_MGR_ERR_NONE;
+
+  /* a new command ends the sequence stepped for the led */
+  ledmgr_seqCancel(id);
+  if (cmd->type == LED_CMD_IR_BRIGHTNESS)
+    err = ledmgr_runIrBrightness(cmd->brightness, cmd->ramptime);
+  else if (cmd->type == LED_CMD_SEQUENCE)
+    err = ledmgr_runSequence(id, cmd);
+  else
+    err = ledmgr_runOp(id, cmd->op, cmd->color, cmd->group);
+  if (cmd->type == LED_CMD_SEQUENCE && err == LED_MGR_ERR_OPERATION_NOT_SUPPORTED)
+    err = ledmgr_seqStart(id, cmd);
+  if (err != LED_MGR_ERR_NONE)
+    LEDMGR_LOG_ERROR("Led %d command %d failed, err %d", id, cmd->type, err);
+
+  return err;
+}
+
+/* Owner thread of a led, runs the latest command queued for the led */
+static void* ledmgr_ownerThread(void *arg)
+{
+  ledId_t id = (ledId_t)(intptr_t)arg;
+  ledCmdSlot *slot = &g_ledCmdSlot[id];
+  ledCmd cmd;
+  uint32_t queued = 0;
+
+  pthread_mutex_lock(&ledcmdmutex);
+  while (true)
+  {
+    while (slot->taken == slot->queued)
+      pthread_cond_wait(&slot->cond, &ledcmdmutex);
+    /* commands queued before the latest one are superseded by it */
+    cmd = slot->cmd;
+    queued = slot->queued;
+    /* the command is ours now, a newer one does not release its group */
+    slot->taken = queued;
+    pthread_mutex_unlock(&ledcmdmutex);
+
+    ledmgr_runCmd(id, &cmd);
+
+    pthread_mutex_lock(&ledcmdmutex);
+    ledmgr_groupDone(cmd.group, id);
+    slot->done = queued;
+    pthread_cond_broadcast(&ledcmddonecond);
+  }
+
+  return NULL;
+}
+
+/* Start the owner thread of every led */
+static void ledmgr_startOwners(void)
+{
+  pthread_attr_t attr;
+  pthread_t thread;
+  int id = LED_ID_CAMERA_FRONT_PANEL;
+
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++)
+  {
+    pthread_cond_init(&g_ledCmdSlot[id].cond, NULL);
+    g_ledCmdSlot[id].owned = (pthread_create(&thread, &attr, ledmgr_ownerThread, (void *)(intptr_t)id) == 0);
+    if (!g_ledCmdSlot[id].owned)
+      LEDMGR_LOG_ERROR("Unable to create owner thread of led %d, commands run by the caller", id);
+  }
+  pthread_attr_destroy(&attr);
+}
+
+/* Queue a command for the owner thread of a led, replacing a command not yet taken */
+static ledMgrErr_t ledmgr_queueCmd(ledId_t id, const ledCmd *cmd)
+{
+  ledCmdSlot *slot = &g_ledCmdSlot[id];
+  ledCmd alone;
+
+  pthread_once(&ledcmdonce, ledmgr_startOwners);
+  if (!slot->owned) {
+    /* run by the caller, the other leds of the state are not queued yet */
+    pthread_mutex_lock(&ledcmdmutex);
+    ledmgr_groupDone(cmd->group, id);
+    pthread_mutex_unlock(&ledcmdmutex);
+    alone = *cmd;
+    alone.group = NULL;
+    return ledmgr_runCmd(id, &alone);
+  }
+
+  pthread_mutex_lock(&ledcmdmutex);
+  if (slot->taken != slot->queued) {
+    LEDMGR_LOG_DEBUG("Led %d command %d superseded by command %d", id, slot->cmd.type, cmd->type);
+    ledmgr_groupDone(slot->cmd.group, id);
+  }
+  slot->cmd = *cmd;
+  slot->queued++;
+  pthread_cond_signal(&slot->cond);
+  pthread_mutex_unlock(&ledcmdmutex);
+
+  return LED_MGR_ERR_NONE;
+}
+
+/* Queue the commands of a state for the camera and xw leds, applied together */
+static void ledmgr_queueState(ledMgrState_t state, ledCmd *camera, ledCmd *xw)
+{
+  pthread_condattr_t condattr;
+  ledCmdGroup *group = (ledCmdGroup *)calloc(1, sizeof(ledCmdGroup));
+
+  if (group != NULL) {
+    group->state = state;
+    group->staging = 2;
+    group->running = 2;
+    group->start = ledmgr_now();
+    pthread_condattr_init(&condattr);
+    pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&group->cond, &condattr);
+    pthread_condattr_destroy(&condattr);
+  }
+  else
+    LEDMGR_LOG_ERROR("Unable to allocate led group, leds of state %d applied apart", state);
+  camera->group = group;
+  xw->group = group;
+
+  ledmgr_queueCmd(LED_ID_CAMERA_FRONT_PANEL, camera);
+  ledmgr_queueCmd(LED_ID_XW_FRONT_PANEL, xw);
+}
+
+/* API to wait for the queued led commands */
+ledMgrErr_t ledmgr_flush(void)
+{
+  uint32_t queued[LED_ID_MAX] = {0};
+  int id = LED_ID_CAMERA_FRONT_PANEL;
+
+  pthread_once(&ledcmdonce, ledmgr_startOwners);
+  pthread_mutex_lock(&ledcmdmutex);
+  for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++)
+    queued[id] = g_ledCmdSlot[id].queued;
+  /* commands queued from now on are not waited for */
+  for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++)
+  {
+    while ((int32_t)(g_ledCmdSlot[id].done - queued[id]) < 0)
+      pthread_cond_wait(&ledcmddonecond, &ledcmdmutex);
+  }
+  pthread_mutex_unlock(&ledcmdmutex);
+
+  return LED_MGR_ERR_NONE;
+}
+
+/* Fill an operation command */
+static ledCmd* ledmgr_opCmd(ledCmd *cmd, ledMgrOp_t op, ledMgrColor_t color)
+{
+  memset(cmd, 0, sizeof(*cmd));
+  cmd->type = LED_CMD_OP;
+  cmd->op = op;
+  cmd->color = color;
+
+  return cmd;
+}
+
+/* Fill a color sequence command */
+static ledCmd* ledmgr_sequenceCmd(ledCmd *cmd, const ledMgrColor_t *colors, uint32_t count, uint32_t steptime)
+{
+  memset(cmd, 0, sizeof(*cmd));
+  cmd->type = LED_CMD_SEQUENCE;
+  memcpy(cmd->colors, colors, count * sizeof(ledMgrColor_t));
+  cmd->count = count;
+  cmd->steptime = steptime;
+
+  return cmd;
+}
+
+/* API to set led operation and color */
+ledMgrErr_t ledmgr_setOp(ledId_t id, ledMgrOp_t op, ledMgrColor_t color)
+{
+  ledRGBColor rgb;
+  ledCmd cmd;
+
+  if (id == LED_ID_XW_FRONT_PANEL) {
+    return led_xw_setOp(id, op, color);
+  }
+  if(id < LED_ID_CAMERA_FRONT_PANEL || id >= LED_ID_MAX || getOpVal(op) == NULL || getColorVal(color, &rgb) == NULL){
+    LEDMGR_LOG_ERROR("Unable to get led, color or operation %d %d %d", id, op, color);
+    return LED_MGR_ERR_INVALID_PARAM;
+  }
+
+  return ledmgr_queueCmd(id, ledmgr_opCmd(&cmd, op, color));
+}
+
+/* API to set IR led brightness */
+ledMgrErr_t ledmgr_setIrBrightness(uint8_t brightness, uint32_t ramptime)
+{
+  ledCmd cmd;
+
+  memset(&cmd, 0, sizeof(cmd));
+  cmd.type = LED_CMD_IR_BRIGHTNESS;
+  cmd.brightness = brightness;
+  cmd.ramptime = ramptime;
+
+  return ledmgr_queueCmd(LED_ID_CAMERA_IR, &cmd);
+}
+
+/* API to cycle a led through colors */
+ledMgrErr_t ledmgr_setColorSequence(ledId_t id, const ledMgrColor_t *colors, uint32_t count, uint32_t steptime)
+{
+  ledCmd cmd;
+  uint32_t i = 0;
+
+  if(id < LED_ID_CAMERA_FRONT_PANEL || id > LED_ID_XW_FRONT_PANEL || colors == NULL || count == 0 ||
+     count > LED_MGR_SEQUENCE_MAX_COLORS || steptime == 0){
+    LEDMGR_LOG_ERROR("Invalid color sequence of led %d, %d colors of %d ms", id, count, steptime);
+    return LED_MGR_ERR_INVALID_PARAM;
+  }
+  for (i = 0; i < count; i++)
+  {
+    if (colors[i] < LED_MGR_COLOR_AMBER || colors[i] >= LED_MGR_COLOR_MAX) {
+      LEDMGR_LOG_ERROR("Invalid color %d in sequence", colors[i]);
+      return LED_MGR_ERR_INVALID_PARAM;
+    }
+  }
+
+  return ledmgr_queueCmd(id, ledmgr_sequenceCmd(&cmd, colors, count, steptime));
+}
+
+/* API to set xw led operation and color */
+static ledMgrErr_t led_xw_setOp(ledId_t id, ledMgrOp_t op, ledMgrColor_t color)
+{
+  ledRGBColor rgb;
+  ledCmd cmd;
+
+  if(getOpVal(op) == NULL || getxwColorVal(color, &rgb) == NULL){
+    LEDMGR_LOG_ERROR("Unable to get color or operation %d %d", op, color);
+    return LED_MGR_ERR_INVALID_PARAM;
+  }
+
+  return ledmgr_queueCmd(id, ledmgr_opCmd(&cmd, op, color));
+}
@@ -60,9 +60,23 @@ typedef enum _ledMgrOp_t{
   LED_MGR_OP_DOUBLE_BLINK,
   LED_MGR_OP_FAST_BLINK,
   LED_MGR_OP_NO_LIGHT,
+  LED_MGR_OP_FADE_IN,
+  LED_MGR_OP_FADE_OUT,
+  LED_MGR_OP_BREATHE,
   LED_MGR_OP_MAX
 }ledMgrOp_t;
 
+/* max colors of a color sequence, see ledmgr_setColorSequence */
+#define LED_MGR_SEQUENCE_MAX_COLORS 8
+
+/* Timing of a color sequence stepped by ledmgr, see ledmgr_getSequenceStats */
+typedef struct _ledMgrSequenceStats_t {
+  uint32_t keyframes;             /* keyframes shown */
+  uint32_t late;                  /* keyframes late by a whole keyframe, the schedule was restarted */
+  uint32_t max_drift_us;          /* largest delay of a keyframe behind its schedule */
+  uint64_t total_drift_us;        /* delay of all keyframes behind their schedule */
+}ledMgrSequenceStats_t;
+
 /* Error codes */
 typedef enum _ledMgrErr_t {
   LED_MGR_ERR_NONE = 0,
@@ -76,6 +90,8 @@ typedef enum _ledMgrErr_t {
 /**
  * @brief Initialize led mgr
  * This API to be called to initialize ledmgr
+ * The led colors of system.conf and xw system.conf are watched from then on, a recalibration
+ * is swapped in and the last state set is applied again with the new colors.
  *
  * @param [in]  id   :  None
  * @param [out]      :  None.
@@ -87,6 +103,8 @@ ledMgrErr_t ledmgr_init(void);
 /**
  * @brief Set led state
  * This API to be called to set the state of led like boot up, fw update etc
+ * The camera and xw led operations are queued together and return at once, each led applies its
+ * operation once both have staged theirs so the leds switch at the same time.
  *
  * @param [in]  id   :  Identifier of a led.
  * @param [out]      :  None.
@@ -98,14 +116,79 @@ ledMgrErr_t ledmgr_setState(ledMgrState_t state);
 /**
  * @brief Set led operation
  * This API to be called to set operation of led like solid/slow/fast/double blink etc
+ * The operation is queued to the owner thread of the led and this API returns without waiting for it.
+ * An operation not yet started is replaced by a newer operation or IR brightness of the same led.
  *
  * @param [in]  id   :  Identifier of a led.
  * @param [out]      :  None.
  *
- * @return Error Code:  If error code is returned then failed.
+ * @return Error Code:  If error code is returned then the operation is invalid and was not queued.
  */
 ledMgrErr_t ledmgr_setOp(ledId_t id, ledMgrOp_t op, ledMgrColor_t color);
 
+/**
+ * @brief Set IR led brightness
+ * This API to be called to turn the IR led on or off, ramping its brightness so switching does not flash
+ *
+ * Queued to the owner thread of the IR led like ledmgr_setOp.
+ *
+ * @param [in]  brightness:  0-255 brightness, 0 - off
+ * @param [in]  ramptime  :  ramp time in ms, 0 - change at once
+ * @param [out]           :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledMgrErr_t ledmgr_setIrBrightness(uint8_t brightness, uint32_t ramptime);
+
+/**
+ * @brief Set led to cycle through colors
+ * This API to be called to show every color for steptime and repeat, queued like ledmgr_setOp.
+ * The sequence is run by the led itself where it can, otherwise the ledmgr sequencer thread steps it until the next operation of the led.
+ *
+ * @param [in]  id       :  Identifier of a led, CAMERA or XW.
+ * @param [in]  colors   :  colors of the sequence.
+ * @param [in]  count    :  number of colors, 1~LED_MGR_SEQUENCE_MAX_COLORS.
+ * @param [in]  steptime :  time of every color in ms.
+ * @param [out]          :  None.
+ *
+ * @return Error Code:  If error code is returned then the sequence is invalid and was not queued.
+ */
+ledMgrErr_t ledmgr_setColorSequence(ledId_t id, const ledMgrColor_t *colors, uint32_t count, uint32_t steptime);
+
+/**
+ * @brief Get color sequence timing
+ * This API to be called to get how far the keyframes of the sequence stepped by ledmgr drifted from their schedule
+ *
+ * @param [in]  id   :  Identifier of a led.
+ * @param [out] stats:  timing of the current or last sequence of the led.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledMgrErr_t ledmgr_getSequenceStats(ledId_t id, ledMgrSequenceStats_t *stats);
+
+/**
+ * @brief Check whether a led effect is run by this process
+ * Color sequences stepped by ledmgr and some blinks run on threads of the calling process, they stop when it exits.
+ * Short-lived callers have to keep running while this reports an effect to keep it going.
+ *
+ * @param [in]  id     :  Identifier of a led.
+ * @param [out] running:  1 a blink or color sequence of the led is run by this process, 0 otherwise.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledMgrErr_t ledmgr_getRunning(ledId_t id, int *running);
+
+/**
+ * @brief Wait for queued led operations
+ * This API to be called to wait until every operation queued so far has taken effect or been replaced by a newer one.
+ *
+ * @param [in]       :  None.
+ * @param [out]      :  None.
+ *
+ * @return Error Code:  If error code is returned then failed.
+ */
+ledMgrErr_t ledmgr_flush(void);
+
 //int ledmgr_setColor(ledId_t id, ledColor_t color);
 
 #ifdef __cplusplus
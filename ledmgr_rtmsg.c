@@ -339,6 +339,47 @@ int xw_led_setBlinkSequence(int ledid,uint32_t ontime, uint32_t offtime1, uint32
 	return retval;
 }
 
+int xw_led_setColorSequence(int ledid, const uint8_t (*colors)[6], const uint32_t *durations, uint32_t count)
+{
+	rtMessage res=NULL;
+	rtMessage req=NULL;
+	rtError err;
+	int retval=-1;
+	char const* state = NULL;
+	char steps[512] = {0};
+	uint32_t len = 0;
+	uint32_t i = 0;
+	/* every step as current:pwm of R,G,B like led_color of system.conf, then @time in ms, steps separated by ; */
+	for (i = 0; i < count && len < sizeof(steps); i++)
+	{
+		len += snprintf(steps + len, sizeof(steps) - len, "%s%d:%d,%d:%d,%d:%d@%u", i ? ";" : "",
+			colors[i][0], colors[i][1], colors[i][2], colors[i][3], colors[i][4], colors[i][5], durations[i]);
+	}
+	rtMessage_Create(&req);
+	rtMessage_SetString(req, "fname", "xw_led_setColorSequence");
+	rtMessage_SetInt32(req, "ledid",ledid);
+	rtMessage_SetInt32(req, "count", count);
+	rtMessage_SetString(req, "steps", steps);
+	err = rtConnection_SendRequest(con, req, "XW4.LEDSETCOLORSEQUENCE", &res, 2000);
+	rtLog_Debug("SendRequest:%s", rtStrError(err));
+	if (err == RT_OK)
+	{
+		char* p = NULL;
+		uint32_t len = 0;
+
+		rtMessage_ToString(res, &p, &len);
+		rtLog_Debug("\tres:%.*s\n", len, p);
+		free(p);
+		rtMessage_GetInt32(res,"retval",&retval);
+		rtMessage_GetString(res,"state",&state);
+		rtLog_Debug("returnval: %d %s \n",retval,state);
+	}
+	rtMessage_Release(req);
+	if(res != NULL)
+		rtMessage_Release(res);
+	return retval;
+}
+
 int xw_led_setOnOff(int ledid,const char* onoff)
 {
 	rtMessage res=NULL;
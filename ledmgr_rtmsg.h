@@ -32,6 +32,10 @@ int xw_led_setBlink(int ledid,uint32_t offtime, uint32_t ontime);
 
 int xw_led_setBlinkSequence(int ledid,uint32_t ontime, uint32_t offtime1, uint32_t count, uint32_t offtime2);
 
+/* colors holds current:pwm of R,G,B for every step, returns LED_ERR_OPERATION_NOT_SUPPORTED if the xw replied
+ * it can not run sequences, -1 if it did not answer */
+int xw_led_setColorSequence(int ledid, const uint8_t (*colors)[6], const uint32_t *durations, uint32_t count);
+
 int xw_led_setOnOff(int ledid,const char* onoff);
 
 int xw_led_applySettings(int ledid);
@@ -23,6 +23,7 @@
  #include <stdlib.h>
  #include <getopt.h>
  #include <string.h>
+ #include <unistd.h>
  #include "ledmgrlogger.h"
  #include "ledmgr.h"
 
@@ -37,6 +38,8 @@ static ledMgrColor_t ledColorFromString(char const* s);
 static void logLevelFromString(char const* s);
 static void logDestinationFromString(char const* s);
 static void print_usage(void);
+static void print_stats(void);
+static bool ledtest_running(void);
 
 static ledId_t ledIdFromString(char const* s)
 {
@@ -86,6 +89,12 @@ static ledMgrOp_t ledOperationFromString(char const* s)
     return LED_MGR_OP_FAST_BLINK;
   if(strcmp(s, "NO_LIGHT") == 0)
     return LED_MGR_OP_NO_LIGHT;
+  if(strcmp(s, "FADE_IN") == 0)
+    return LED_MGR_OP_FADE_IN;
+  if(strcmp(s, "FADE_OUT") == 0)
+    return LED_MGR_OP_FADE_OUT;
+  if(strcmp(s, "BREATHE") == 0)
+    return LED_MGR_OP_BREATHE;
 
   return LED_MGR_OP_MAX;
 }
@@ -136,6 +145,9 @@ static struct option long_options[] =
   { "state",        required_argument, 0, 's' },
   { "operation",    required_argument, 0, 'o' },
   { "color",        required_argument, 0, 'c' },
+  { "brightness",   required_argument, 0, 'b' },
+  { "ramp",         required_argument, 0, 'r' },
+  { "stats",        no_argument,       0, 'S' },
   { "help",         no_argument,       0, 'h' },
   { "log-level",    required_argument, 0, 'e' },
   { "logger",       required_argument, 0, 'g' },
@@ -152,9 +164,14 @@ static void print_usage(void)
   printf("\t--state        -s    Led states supported\n"
          "\t                     BOOTUP | INCORRECT_XW | READYTOPAIR | TROUBLE_CONN | NOT_PROVISIONED | WORKING_NORMALLY | 2_WAY_VOICE | FACTORY_MODE \n");
   printf("\t--operation    -o    Led Operations supported\n"
-         "\t                     SOLID_LIGHT | BLINK | SLOW_BLINK | DOUBLE_BLINK | FAST_BLINK | NO_LIGHT \n");
+         "\t                     SOLID_LIGHT | BLINK | SLOW_BLINK | DOUBLE_BLINK | FAST_BLINK | NO_LIGHT | FADE_IN | FADE_OUT | BREATHE \n");
   printf("\t--color        -c    Led Colors supported\n"
          "\t                     WHITE | BLUE | AMBER | GREEN | RED \n");
+  printf("\t--brightness   -b    IR Led brightness\n"
+         "\t                     0 - 255, 0 turns IR Led off \n");
+  printf("\t--ramp         -r    IR Led brightness ramp time\n"
+         "\t                     ms, default 0 \n");
+  printf("\t--stats        -S    Print led hal counters and latencies and exit\n");
   printf("\t--help         -h    Print this help and exit\n");
   printf("\t--log-level    -e    Logging level\n"
          "\t                     CRITICAL | ERROR | WARNING | INFO | DEBUG \n");
@@ -162,6 +179,48 @@ static void print_usage(void)
          "\t                     RDKLOG | STDOUT\n");
 }
 
+static void print_stats(void)
+{
+  ledStats_t stats;
+  ledLatency_t latency;
+  int which = 0;
+  int bucket = 0;
+
+  if (LED_ERR_NONE == led_getStats(&stats)) {
+    printf("program cache hits %u misses %u, engine reload skips %u, apply noops %u, writes avoided %u\n",
+           stats.program_cache_hits, stats.program_cache_misses, stats.engine_reload_skips, stats.apply_noops, stats.writes_avoided);
+    printf("config lock retries %u, open retries %u\n", stats.config_lock_retries, stats.open_retries);
+  }
+
+  for (which = LED_LATENCY_INIT; which < LED_LATENCY_MAX; which++) {
+    if (LED_ERR_NONE != led_getLatency((ledLatencyId_t)which, &latency) || 0 == latency.count)
+      continue;
+    printf("%-22s count %u avg %lluus max %uus\n", led_getLatencyName((ledLatencyId_t)which), latency.count,
+           (unsigned long long)(latency.total_us / latency.count), latency.max_us);
+    for (bucket = 0; bucket < LED_LATENCY_BUCKETS; bucket++) {
+      if (0 == latency.bucket[bucket])
+        continue;
+      if (bucket == LED_LATENCY_BUCKETS - 1)
+        printf("\t>= %8uus %u\n", (LED_LATENCY_BUCKET_MIN_US << bucket) / 2, latency.bucket[bucket]);
+      else
+        printf("\t<  %8uus %u\n", LED_LATENCY_BUCKET_MIN_US << bucket, latency.bucket[bucket]);
+    }
+  }
+}
+
+static bool ledtest_running(void)
+{
+  int id = LED_ID_CAMERA_FRONT_PANEL;
+  int running = 0;
+
+  for (id = LED_ID_CAMERA_FRONT_PANEL; id < LED_ID_MAX; id++) {
+    if (LED_MGR_ERR_NONE == ledmgr_getRunning((ledId_t)id, &running) && running)
+      return true;
+  }
+
+  return false;
+}
+
 int main(int argc, char* argv[])
 {
   ledmgr_init();
@@ -169,10 +228,13 @@ int main(int argc, char* argv[])
   ledMgrState_t state = LED_MGR_STATE_UNKNOWN;
   ledMgrOp_t op = LED_MGR_OP_MAX;
   ledMgrColor_t color = LED_MGR_COLOR_MAX;
+  int brightness = -1;
+  uint32_t ramptime = 0;
+  bool stats = false;
   while (true)
   {
     int option_index = 0;
-    int c = getopt_long(argc, argv, "l:s:o:c:e:g:h", long_options, &option_index);
+    int c = getopt_long(argc, argv, "l:s:o:c:b:r:Se:g:h", long_options, &option_index);
     if (c == -1)
       break;
     switch (c)
@@ -195,7 +257,7 @@ int main(int argc, char* argv[])
       
       case 'o':
         op = ledOperationFromString(optarg);
-        if(op < LED_MGR_OP_SOLID_LIGHT || op > LED_MGR_OP_NO_LIGHT) {
+        if(op < LED_MGR_OP_SOLID_LIGHT || op >= LED_MGR_OP_MAX) {
           printf("Invalid Operation. Try again...\n");
           op = LED_MGR_OP_MAX;
         }
@@ -209,6 +271,22 @@ int main(int argc, char* argv[])
         }
         break;
   
+      case 'b':
+        brightness = atoi(optarg);
+        if(brightness < 0 || brightness > 255) {
+          printf("Invalid Brightness. Try again...\n");
+          brightness = -1;
+        }
+        break;
+
+      case 'r':
+        ramptime = (uint32_t)strtoul(optarg, NULL, 10);
+        break;
+
+      case 'S':
+        stats = true;
+        break;
+
       case 'e':
         logLevelFromString(optarg);
         break;
@@ -222,19 +300,35 @@ int main(int argc, char* argv[])
     }
   }
  
-  if(state != LED_MGR_STATE_UNKNOWN) {
+  if(stats) {
+    print_stats();
+  }
+  else if(state != LED_MGR_STATE_UNKNOWN) {
     ledmgr_setState(state);
   }
   else if (op != LED_MGR_OP_MAX && color != LED_MGR_COLOR_MAX){
     ledmgr_setOp(id, op, color);
   }
-  else if(id == LED_ID_CAMERA_IR){
-    //TODO : Need to support IR led's
-    printf("IR leds not supported yet.\n");
-  } 
+  else if(id == LED_ID_CAMERA_IR && brightness >= 0){
+    ledmgr_setIrBrightness((uint8_t)brightness, ramptime);
+    ledmgr_flush();
+    /* the ramp is run by this process, let it finish */
+    usleep((ramptime + 100) * 1000);
+  }
   else {
     print_usage();
   }
 
+  /* operations are run by owner threads of this process, let them finish */
+  ledmgr_flush();
+
+  /* a blink or color sequence run by this process stops with it, hold it until it stops */
+  if(ledtest_running()) {
+    printf("Led effect is run by ledtest, interrupt it to stop\n");
+    fflush(stdout);
+    while(ledtest_running())
+      sleep(1);
+  }
+
   return 0;
 }